@@ -0,0 +1,113 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <QFile>
+#include <QJsonDocument>
+
+#include "TriangleSoa.h"
+
+double FrameTimings::percentile(const double p) const {
+    if (m_samples.empty()) {
+        return 0.0;
+    }
+
+    auto sorted = m_samples;
+    std::sort(sorted.begin(), sorted.end());
+    const auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+QJsonObject FrameTimings::toJson() const {
+    return {
+        {"p50", percentile(50.0)},
+        {"p95", percentile(95.0)},
+        {"p99", percentile(99.0)},
+    };
+}
+
+QJsonObject PickingBenchmark::toJson() const {
+    const double linearPerRay = rays > 0 ? linearMillis * 1000.0 / rays : 0.0;
+    const double linearVectorizedPerRay = rays > 0 ? linearVectorizedMillis * 1000.0 / rays : 0.0;
+    const double bvhPerRay = rays > 0 ? bvhMillis * 1000.0 / rays : 0.0;
+    return {
+        {"rays", rays},
+        {"hits", hits},
+        {"mismatches", mismatches},
+        {"kernel", TriangleSoa::kernelName()},
+        {"linear_us_per_ray", linearPerRay},
+        {"linear_vectorized_us_per_ray", linearVectorizedPerRay},
+        {"bvh_us_per_ray", bvhPerRay},
+        {"speedup", bvhPerRay > 0.0 ? linearPerRay / bvhPerRay : 0.0},
+    };
+}
+
+QJsonObject GeometryStats::toJson() const {
+    return {
+        {"vertices", vertices},
+        {"indices", indices},
+        {"vertex_bytes", vertexBytes},
+        {"index_bytes", indexBytes},
+        {"mean_drawn_indices", meanDrawnIndices},
+        // what the de-indexed soup used to upload and shade
+        {"soup_vertices", indices},
+    };
+}
+
+QJsonObject TextureStats::toJson() const {
+    return {
+        {"encoding", encoding},
+        {"layers", layers},
+        {"levels", levels},
+        {"bytes", bytes},
+        {"rgba8_top_level_bytes", rgba8TopLevelBytes},
+    };
+}
+
+QJsonObject StateCacheStats::toJson() const {
+    return {
+        {"pipelines", static_cast<qint64>(pipelines)},
+        {"pipeline_creations_during_frames", static_cast<qint64>(pipelineCreationsDuringFrames)},
+        {"max_pipeline_creations_per_frame", static_cast<qint64>(maxPipelineCreationsPerFrame)},
+    };
+}
+
+QJsonObject BenchmarkReport::toJson() const {
+    return {
+        {"backend", backend},
+        {"frames", frameCount},
+        {"instances", instances},
+        {"startup_ms", startupMillis},
+        {"fully_loaded_ms", fullyLoadedMillis},
+        {"frame_cpu_ms", frameTimes.toJson()},
+        {"custom_render_ms", customRenderTimes.toJson()},
+        {"frame_gpu_ms", gpuFrameTimes.toJson()},
+        {"picking", picking.toJson()},
+        {"geometry", geometry.toJson()},
+        {"textures", textures.toJson()},
+        {"state_cache", stateCache.toJson()},
+        {"hover", QJsonObject{
+            {"requests", hoverRequests},
+            {"results_shown", static_cast<qint64>(hoverLatencies.size())},
+            {"coalesced", static_cast<qint64>(hoverCoalesced)},
+            {"latency_ms", hoverLatencies.toJson()},
+        }},
+    };
+}
+
+void BenchmarkReport::write(const QString &outputPath) const {
+    const auto json = QJsonDocument(toJson()).toJson(QJsonDocument::Compact);
+    std::cout << json.toStdString() << std::endl;
+
+    if (outputPath.isEmpty()) {
+        return;
+    }
+
+    QFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::cerr << "Error writing benchmark report: " << outputPath.toStdString() << std::endl;
+        return;
+    }
+    file.write(json);
+}
@@ -0,0 +1,114 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QSize>
+#include <QString>
+#include <vector>
+
+
+struct BenchmarkOptions {
+    int frameCount = 600;
+    QSize pixelSize = QSize(1280, 720);
+    // started at the very top of main(), used for measuring startup time
+    QElapsedTimer processTimer;
+    // empty means printing the report to stdout only
+    QString outputPath;
+};
+
+// collects samples in milliseconds and reports nearest-rank percentiles
+class FrameTimings {
+public:
+    void reserve(const size_t count) {
+        m_samples.reserve(count);
+    }
+
+    void add(const double millis) {
+        m_samples.push_back(millis);
+    }
+
+    size_t size() const {
+        return m_samples.size();
+    }
+
+    double percentile(double p) const;
+    QJsonObject toJson() const;
+
+private:
+    std::vector<double> m_samples;
+};
+
+struct PickingBenchmark {
+    int rays = 0;
+    int hits = 0;
+    // rays for which the accelerated picking disagrees with the linear scan
+    int mismatches = 0;
+    double linearMillis = 0.0;
+    double linearVectorizedMillis = 0.0;
+    double bvhMillis = 0.0;
+
+    QJsonObject toJson() const;
+};
+
+// uploaded geometry, to compare against the de-indexed soup (one vertex per triangle corner)
+struct GeometryStats {
+    qint64 vertices = 0;
+    qint64 indices = 0;
+    qint64 vertexBytes = 0;
+    qint64 indexBytes = 0;
+    // per frame, after level of detail selection
+    double meanDrawnIndices = 0.0;
+
+    QJsonObject toJson() const;
+};
+
+// texture array memory, to compare against single level RGBA8 layers
+struct TextureStats {
+    QString encoding;
+    int layers = 0;
+    int levels = 0;
+    qint64 bytes = 0;
+    qint64 rgba8TopLevelBytes = 0;
+
+    QJsonObject toJson() const;
+};
+
+struct StateCacheStats {
+    // built by customInit
+    quint64 pipelines = 0;
+    // zero when every render state combination was built up front
+    quint64 pipelineCreationsDuringFrames = 0;
+    quint64 maxPipelineCreationsPerFrame = 0;
+
+    QJsonObject toJson() const;
+};
+
+struct BenchmarkReport {
+    QString backend;
+    int frameCount = 0;
+    // specimens of the comparison view, every entity draw covers all of them
+    int instances = 1;
+    // until the first frame was presented
+    double startupMillis = 0.0;
+    // until every part of the model was on screen
+    double fullyLoadedMillis = 0.0;
+    FrameTimings frameTimes;
+    FrameTimings customRenderTimes;
+    // empty when the backend reports no GPU timestamps
+    FrameTimings gpuFrameTimes;
+    PickingBenchmark picking;
+    GeometryStats geometry;
+    TextureStats textures;
+    StateCacheStats stateCache;
+    // from the mouse event to the frame that first shows the hover highlight
+    FrameTimings hoverLatencies;
+    int hoverRequests = 0;
+    // requests replaced by a newer one before their result was shown
+    unsigned int hoverCoalesced = 0;
+
+    QJsonObject toJson() const;
+    void write(const QString &outputPath) const;
+};
+
+
+#endif //BENCHMARK_H
@@ -0,0 +1,200 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+void Aabb::grow(const QVector3D point) {
+    min = QVector3D(std::min(min.x(), point.x()), std::min(min.y(), point.y()), std::min(min.z(), point.z()));
+    max = QVector3D(std::max(max.x(), point.x()), std::max(max.y(), point.y()), std::max(max.z(), point.z()));
+}
+
+void Aabb::grow(const Aabb &other) {
+    grow(other.min);
+    grow(other.max);
+}
+
+float Aabb::surfaceArea() const {
+    const auto extent = max - min;
+    if (extent.x() < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+std::optional<float> Aabb::intersect(const QVector3D rayOrigin, const QVector3D rayInvDir, const float tMax) const {
+    const auto t0 = (min - rayOrigin) * rayInvDir;
+    const auto t1 = (max - rayOrigin) * rayInvDir;
+
+    const float tNear = std::max({std::min(t0.x(), t1.x()), std::min(t0.y(), t1.y()), std::min(t0.z(), t1.z())});
+    const float tFar = std::min({std::max(t0.x(), t1.x()), std::max(t0.y(), t1.y()), std::max(t0.z(), t1.z())});
+
+    if (tFar < tNear || tFar < 0.0f || tNear > tMax) {
+        return std::nullopt;
+    }
+    // origin inside the box
+    return std::max(tNear, 0.0f);
+}
+
+void Bvh::build(const std::vector<Aabb> &primitiveBounds) {
+    const auto primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+
+    m_nodes.clear();
+    m_primitiveOrder.resize(primitiveCount);
+    std::iota(m_primitiveOrder.begin(), m_primitiveOrder.end(), 0);
+
+    if (primitiveCount == 0) {
+        return;
+    }
+
+    std::vector<QVector3D> centroids;
+    centroids.reserve(primitiveCount);
+    for (const auto &bounds: primitiveBounds) {
+        centroids.push_back(bounds.centroid());
+    }
+
+    // a binary tree with n leaves never has more than 2n - 1 nodes, no reallocation while subdividing
+    m_nodes.reserve(2 * primitiveCount - 1);
+    m_nodes.push_back({Aabb(), 0, primitiveCount});
+    updateNodeBounds(0, primitiveBounds);
+    subdivide(0, primitiveBounds, centroids, 0);
+    m_nodes.shrink_to_fit();
+}
+
+Bvh Bvh::fromNodes(std::vector<BvhNode> nodes) {
+    Bvh bvh;
+    bvh.m_nodes = std::move(nodes);
+    return bvh;
+}
+
+bool Bvh::validNodes(const std::vector<BvhNode> &nodes, const uint32_t primitiveCount) {
+    if (nodes.empty()) {
+        return primitiveCount == 0;
+    }
+
+    // children come after their parent, one pass sees every parent first; -1 for nodes no parent referenced yet
+    std::vector<int> depths(nodes.size(), -1);
+    depths[0] = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const auto &node = nodes[i];
+        if (depths[i] < 0) {
+            return false;
+        }
+        if (node.isLeaf()) {
+            if (node.leftFirst > primitiveCount || node.count > primitiveCount - node.leftFirst) {
+                return false;
+            }
+            continue;
+        }
+        if (node.leftFirst <= i || node.leftFirst >= nodes.size() - 1 || depths[i] + 1 > MAX_DEPTH - 1 ||
+            depths[node.leftFirst] != -1 || depths[node.leftFirst + 1] != -1) {
+            return false;
+        }
+        depths[node.leftFirst] = depths[i] + 1;
+        depths[node.leftFirst + 1] = depths[i] + 1;
+    }
+    return true;
+}
+
+void Bvh::updateNodeBounds(const uint32_t nodeIndex, const std::vector<Aabb> &primitiveBounds) {
+    auto &node = m_nodes[nodeIndex];
+    node.bounds = Aabb();
+    for (uint32_t i = 0; i < node.count; ++i) {
+        node.bounds.grow(primitiveBounds[m_primitiveOrder[node.leftFirst + i]]);
+    }
+}
+
+void Bvh::subdivide(const uint32_t nodeIndex, const std::vector<Aabb> &primitiveBounds,
+                    const std::vector<QVector3D> &centroids, const int depth) {
+    const uint32_t first = m_nodes[nodeIndex].leftFirst;
+    const uint32_t count = m_nodes[nodeIndex].count;
+
+    // the traversal stack is as deep as the tree
+    if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH - 1) {
+        return;
+    }
+
+    Aabb centroidBounds;
+    for (uint32_t i = 0; i < count; ++i) {
+        centroidBounds.grow(centroids[m_primitiveOrder[first + i]]);
+    }
+
+    struct Bin {
+        Aabb bounds;
+        uint32_t count = 0;
+    };
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const float axisMin = centroidBounds.min[axis];
+        const float axisExtent = centroidBounds.max[axis] - axisMin;
+        if (axisExtent <= 0.0f) {
+            continue;
+        }
+
+        const float binScale = BIN_COUNT / axisExtent;
+        std::array<Bin, BIN_COUNT> bins{};
+        for (uint32_t i = 0; i < count; ++i) {
+            const auto primitive = m_primitiveOrder[first + i];
+            const int binIndex = std::min(BIN_COUNT - 1,
+                                          static_cast<int>((centroids[primitive][axis] - axisMin) * binScale));
+            bins[binIndex].count++;
+            bins[binIndex].bounds.grow(primitiveBounds[primitive]);
+        }
+
+        // sweep from both sides, a split after bin i puts bins [0, i] to the left
+        std::array<float, BIN_COUNT - 1> leftArea{};
+        std::array<uint32_t, BIN_COUNT - 1> leftCount{};
+        Aabb leftBox;
+        uint32_t leftSum = 0;
+        for (int i = 0; i < BIN_COUNT - 1; ++i) {
+            leftSum += bins[i].count;
+            leftBox.grow(bins[i].bounds);
+            leftCount[i] = leftSum;
+            leftArea[i] = leftBox.surfaceArea();
+        }
+
+        Aabb rightBox;
+        uint32_t rightSum = 0;
+        for (int i = BIN_COUNT - 1; i > 0; --i) {
+            rightSum += bins[i].count;
+            rightBox.grow(bins[i].bounds);
+            const float cost = leftCount[i - 1] * leftArea[i - 1] + rightSum * rightBox.surfaceArea();
+            if (leftCount[i - 1] > 0 && rightSum > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    const float leafCost = count * m_nodes[nodeIndex].bounds.surfaceArea();
+    if (bestAxis == -1 || bestCost >= leafCost) {
+        return;
+    }
+
+    const float axisMin = centroidBounds.min[bestAxis];
+    const float binScale = BIN_COUNT / (centroidBounds.max[bestAxis] - axisMin);
+    const auto middle = std::partition(
+        m_primitiveOrder.begin() + first, m_primitiveOrder.begin() + first + count,
+        [&](const uint32_t primitive) {
+            const int binIndex = std::min(BIN_COUNT - 1,
+                                          static_cast<int>((centroids[primitive][bestAxis] - axisMin) * binScale));
+            return binIndex < bestSplit;
+        });
+    const auto leftCount = static_cast<uint32_t>(middle - (m_primitiveOrder.begin() + first));
+
+    const auto leftIndex = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({Aabb(), first, leftCount});
+    m_nodes.push_back({Aabb(), first + leftCount, count - leftCount});
+    updateNodeBounds(leftIndex, primitiveBounds);
+    updateNodeBounds(leftIndex + 1, primitiveBounds);
+
+    m_nodes[nodeIndex].leftFirst = leftIndex;
+    m_nodes[nodeIndex].count = 0;
+
+    subdivide(leftIndex, primitiveBounds, centroids, depth + 1);
+    subdivide(leftIndex + 1, primitiveBounds, centroids, depth + 1);
+}
@@ -0,0 +1,154 @@
+#ifndef BVH_H
+#define BVH_H
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+#include <qvectornd.h>
+
+
+struct Aabb {
+    QVector3D min = QVector3D(std::numeric_limits<float>::max(),
+                              std::numeric_limits<float>::max(),
+                              std::numeric_limits<float>::max());
+    QVector3D max = QVector3D(std::numeric_limits<float>::lowest(),
+                              std::numeric_limits<float>::lowest(),
+                              std::numeric_limits<float>::lowest());
+
+    void grow(QVector3D point);
+    void grow(const Aabb &other);
+    float surfaceArea() const;
+
+    QVector3D centroid() const {
+        return (min + max) * 0.5f;
+    }
+
+    // slab test, returns the entry distance when the ray hits the box before tMax
+    std::optional<float> intersect(QVector3D rayOrigin, QVector3D rayInvDir, float tMax) const;
+};
+
+// 32 bytes, two nodes per cache line; children of an inner node are always adjacent
+struct BvhNode {
+    Aabb bounds;
+    // first child for inner nodes, first primitive for leaves
+    uint32_t leftFirst = 0;
+    // 0 for inner nodes
+    uint32_t count = 0;
+
+    bool isLeaf() const {
+        return count > 0;
+    }
+};
+
+static_assert(sizeof(BvhNode) == 32);
+
+// Bounding volume hierarchy over arbitrary primitives, built with binned surface area heuristic
+// and flattened into a depth-first node array.
+class Bvh {
+public:
+    // Leaves reference ranges of primitiveOrder(), callers either reorder their primitives
+    // to match (then leaf ranges index them directly) or look the original index up.
+    void build(const std::vector<Aabb> &primitiveBounds);
+
+    // adopts nodes of a previously built hierarchy (mesh cache), primitiveOrder() is empty afterwards
+    static Bvh fromNodes(std::vector<BvhNode> nodes);
+    // whether nodes could have come from build over primitiveCount primitives: leaf ranges within them, children after
+    // their parent and referenced once, no deeper than the traversal stack
+    static bool validNodes(const std::vector<BvhNode> &nodes, uint32_t primitiveCount);
+
+    const std::vector<BvhNode> &nodes() const {
+        return m_nodes;
+    }
+
+    const std::vector<uint32_t> &primitiveOrder() const {
+        return m_primitiveOrder;
+    }
+
+    Aabb bounds() const {
+        return m_nodes.empty() ? Aabb() : m_nodes[0].bounds;
+    }
+
+    size_t nodeCount() const {
+        return m_nodes.size();
+    }
+
+    // Visits leaves front to back and skips every node whose box starts behind closestDistance.
+    // intersectLeaf(first, count, closestDistance&) tests positions [first, first + count) of primitiveOrder()
+    // and lowers closestDistance on a hit.
+    template<typename IntersectLeaf>
+    void traverse(QVector3D rayOrigin, QVector3D rayDir, float &closestDistance, IntersectLeaf &&intersectLeaf) const;
+
+private:
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr int BIN_COUNT = 12;
+    static constexpr int MAX_DEPTH = 64;
+
+    void updateNodeBounds(uint32_t nodeIndex, const std::vector<Aabb> &primitiveBounds);
+    void subdivide(uint32_t nodeIndex, const std::vector<Aabb> &primitiveBounds,
+                   const std::vector<QVector3D> &centroids, int depth);
+
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_primitiveOrder;
+};
+
+template<typename IntersectLeaf>
+void Bvh::traverse(const QVector3D rayOrigin, const QVector3D rayDir, float &closestDistance,
+                   IntersectLeaf &&intersectLeaf) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+
+    const auto safeInverse = [](const float d) {
+        constexpr float TINY = 1e-20f;
+        return 1.0f / (std::abs(d) > TINY ? d : std::copysign(TINY, d));
+    };
+    const QVector3D rayInvDir(safeInverse(rayDir.x()), safeInverse(rayDir.y()), safeInverse(rayDir.z()));
+
+    if (!m_nodes[0].bounds.intersect(rayOrigin, rayInvDir, closestDistance).has_value()) {
+        return;
+    }
+
+    std::array<uint32_t, MAX_DEPTH> stack;
+    int stackSize = 0;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const auto &node = m_nodes[nodeIndex];
+        if (node.isLeaf()) {
+            intersectLeaf(node.leftFirst, node.count, closestDistance);
+        } else {
+            uint32_t nearIndex = node.leftFirst;
+            uint32_t farIndex = node.leftFirst + 1;
+            auto nearHit = m_nodes[nearIndex].bounds.intersect(rayOrigin, rayInvDir, closestDistance);
+            auto farHit = m_nodes[farIndex].bounds.intersect(rayOrigin, rayInvDir, closestDistance);
+
+            if (farHit.has_value() && (!nearHit.has_value() || farHit.value() < nearHit.value())) {
+                std::swap(nearIndex, farIndex);
+                std::swap(nearHit, farHit);
+            }
+
+            if (nearHit.has_value()) {
+                if (farHit.has_value()) {
+                    stack[stackSize++] = farIndex;
+                }
+                nodeIndex = nearIndex;
+                continue;
+            }
+        }
+
+        // pop, dropping nodes that a closer hit found in the meantime made irrelevant
+        bool found = false;
+        while (stackSize > 0 && !found) {
+            nodeIndex = stack[--stackSize];
+            found = m_nodes[nodeIndex].bounds.intersect(rayOrigin, rayInvDir, closestDistance).has_value();
+        }
+        if (!found) {
+            return;
+        }
+    }
+}
+
+
+#endif //BVH_H
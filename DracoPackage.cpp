@@ -0,0 +1,697 @@
+#include "DracoPackage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "ParallelFor.h"
+#include "assimp/material.h"
+#include "assimp/scene.h"
+#include "draco/compression/decode.h"
+#include "draco/compression/encode.h"
+#include "draco/mesh/mesh.h"
+
+namespace {
+constexpr quint32 GLB_MAGIC = 0x46546C67; // "glTF"
+constexpr quint32 GLB_VERSION = 2;
+constexpr quint32 GLB_CHUNK_JSON = 0x4E4F534A;
+constexpr quint32 GLB_CHUNK_BIN = 0x004E4942;
+constexpr int GLTF_TRIANGLES = 4;
+constexpr int GLTF_FLOAT = 5126;
+constexpr int GLTF_UNSIGNED_INT = 5125;
+const QString KHR_DRACO = QStringLiteral("KHR_draco_mesh_compression");
+
+struct GlbHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 length;
+};
+
+struct GlbChunkHeader {
+    quint32 length;
+    quint32 type;
+};
+
+static_assert(sizeof(GlbHeader) == 12);
+static_assert(sizeof(GlbChunkHeader) == 8);
+
+struct Span {
+    const char *data = nullptr;
+    qsizetype size = 0;
+};
+
+// Draco attribute unique ids of a mesh, -1 for missing attributes
+struct DracoAttributes {
+    int position = -1;
+    int normal = -1;
+    int texCoord = -1;
+};
+
+std::unique_ptr<draco::Mesh> decodeMesh(const Span bytes) {
+    draco::DecoderBuffer buffer;
+    buffer.Init(bytes.data, bytes.size);
+    draco::Decoder decoder;
+    auto decoded = decoder.DecodeMeshFromBuffer(&buffer);
+    if (!decoded.ok()) {
+        std::cerr << "Error decoding Draco mesh: " << decoded.status().error_msg() << std::endl;
+        return nullptr;
+    }
+    return std::move(decoded).value();
+}
+
+const draco::PointAttribute *attribute(const draco::Mesh &mesh, const int uniqueId,
+                                       const draco::GeometryAttribute::Type type) {
+    return uniqueId >= 0 ? mesh.GetAttributeByUniqueId(uniqueId) : mesh.GetNamedAttribute(type);
+}
+
+// area weighted, for meshes that come without normals
+void computeNormals(aiMesh &mesh) {
+    mesh.mNormals = new aiVector3D[mesh.mNumVertices]();
+    for (unsigned int f = 0; f < mesh.mNumFaces; ++f) {
+        const auto *index = mesh.mFaces[f].mIndices;
+        const auto n = (mesh.mVertices[index[1]] - mesh.mVertices[index[0]]) ^
+                       (mesh.mVertices[index[2]] - mesh.mVertices[index[0]]);
+        for (int c = 0; c < 3; ++c) {
+            mesh.mNormals[index[c]] += n;
+        }
+    }
+    for (unsigned int v = 0; v < mesh.mNumVertices; ++v) {
+        mesh.mNormals[v].NormalizeSafe();
+    }
+}
+
+// glTF puts the texture origin at the top left, assimp and the .drc files of the FBX at the bottom left
+aiMesh *toAiMesh(const draco::Mesh &decoded, const DracoAttributes &ids, const unsigned int materialIndex,
+                 const bool flipV) {
+    const auto *position = attribute(decoded, ids.position, draco::GeometryAttribute::POSITION);
+    const auto *normal = attribute(decoded, ids.normal, draco::GeometryAttribute::NORMAL);
+    const auto *texCoord = attribute(decoded, ids.texCoord, draco::GeometryAttribute::TEX_COORD);
+    if (position == nullptr) {
+        std::cerr << "Error decoding Draco mesh: no positions" << std::endl;
+        return nullptr;
+    }
+
+    auto mesh = std::make_unique<aiMesh>();
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mMaterialIndex = materialIndex;
+    mesh->mNumVertices = decoded.num_points();
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    // without texture coordinates the material texture is sampled at its corner
+    mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices]();
+    mesh->mNumUVComponents[0] = 2;
+    if (normal != nullptr) {
+        mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    }
+    for (draco::PointIndex p(0); p < decoded.num_points(); ++p) {
+        const auto v = p.value();
+        float value[3] = {};
+        position->ConvertValue<float>(position->mapped_index(p), 3, value);
+        mesh->mVertices[v] = aiVector3D(value[0], value[1], value[2]);
+        if (normal != nullptr) {
+            normal->ConvertValue<float>(normal->mapped_index(p), 3, value);
+            mesh->mNormals[v] = aiVector3D(value[0], value[1], value[2]);
+        }
+        if (texCoord != nullptr) {
+            texCoord->ConvertValue<float>(texCoord->mapped_index(p), 2, value);
+            mesh->mTextureCoords[0][v] = aiVector3D(value[0], flipV ? 1.0f - value[1] : value[1], 0.0f);
+        }
+    }
+
+    mesh->mNumFaces = decoded.num_faces();
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (draco::FaceIndex f(0); f < decoded.num_faces(); ++f) {
+        const auto &corners = decoded.face(f);
+        auto &face = mesh->mFaces[f.value()];
+        face.mNumIndices = 3;
+        face.mIndices = new unsigned int[3]{corners[0].value(), corners[1].value(), corners[2].value()};
+    }
+
+    if (normal == nullptr) {
+        computeNormals(*mesh);
+    }
+    return mesh.release();
+}
+
+// the triangles of an imported mesh, every vertex a point of its own with identity mapped attributes
+std::unique_ptr<draco::Mesh> toDracoMesh(const aiMesh &mesh, const bool flipV, DracoAttributes &ids) {
+    auto dracoMesh = std::make_unique<draco::Mesh>();
+    dracoMesh->set_num_points(mesh.mNumVertices);
+
+    const auto addAttribute = [&](const draco::GeometryAttribute::Type type, const int components,
+                                  const std::function<void(unsigned int, float *)> &value) {
+        draco::GeometryAttribute geometryAttribute;
+        geometryAttribute.Init(type, nullptr, components, draco::DT_FLOAT32, false, sizeof(float) * components, 0);
+        const int id = dracoMesh->AddAttribute(geometryAttribute, true, mesh.mNumVertices);
+        auto *pointAttribute = dracoMesh->attribute(id);
+        for (unsigned int v = 0; v < mesh.mNumVertices; ++v) {
+            float data[3];
+            value(v, data);
+            pointAttribute->SetAttributeValue(draco::AttributeValueIndex(v), data);
+        }
+        return static_cast<int>(pointAttribute->unique_id());
+    };
+
+    ids.position = addAttribute(draco::GeometryAttribute::POSITION, 3, [&](const unsigned int v, float *out) {
+        out[0] = mesh.mVertices[v].x;
+        out[1] = mesh.mVertices[v].y;
+        out[2] = mesh.mVertices[v].z;
+    });
+    if (mesh.HasNormals()) {
+        ids.normal = addAttribute(draco::GeometryAttribute::NORMAL, 3, [&](const unsigned int v, float *out) {
+            out[0] = mesh.mNormals[v].x;
+            out[1] = mesh.mNormals[v].y;
+            out[2] = mesh.mNormals[v].z;
+        });
+    }
+    if (mesh.HasTextureCoords(0)) {
+        ids.texCoord = addAttribute(draco::GeometryAttribute::TEX_COORD, 2, [&](const unsigned int v, float *out) {
+            out[0] = mesh.mTextureCoords[0][v].x;
+            out[1] = flipV ? 1.0f - mesh.mTextureCoords[0][v].y : mesh.mTextureCoords[0][v].y;
+        });
+    }
+
+    for (unsigned int f = 0; f < mesh.mNumFaces; ++f) {
+        const auto &face = mesh.mFaces[f];
+        if (face.mNumIndices == 3) {
+            dracoMesh->AddFace({
+                draco::PointIndex(face.mIndices[0]), draco::PointIndex(face.mIndices[1]),
+                draco::PointIndex(face.mIndices[2])
+            });
+        }
+    }
+    return dracoMesh;
+}
+
+QByteArray encodeMesh(const draco::Mesh &mesh, const DracoEncodeOptions &options) {
+    draco::Encoder encoder;
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, options.positionBits);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL, options.normalBits);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::TEX_COORD, options.texCoordBits);
+    encoder.SetSpeedOptions(options.speed, options.speed);
+    encoder.SetEncodingMethod(draco::MESH_EDGEBREAKER_ENCODING);
+
+    draco::EncoderBuffer buffer;
+    const auto status = encoder.EncodeMeshToBuffer(mesh, &buffer);
+    if (!status.ok()) {
+        std::cerr << "Error encoding Draco mesh: " << status.error_msg() << std::endl;
+        return {};
+    }
+    return {buffer.data(), static_cast<qsizetype>(buffer.size())};
+}
+
+// JSON chunk and, when there is one, the BIN chunk of a .glb
+bool parseGlb(const QByteArray &bytes, QJsonObject &json, Span &bin) {
+    GlbHeader header{};
+    if (bytes.size() < static_cast<qsizetype>(sizeof(header))) {
+        return false;
+    }
+    std::memcpy(&header, bytes.constData(), sizeof(header));
+    if (header.magic != GLB_MAGIC || header.version != GLB_VERSION) {
+        return false;
+    }
+
+    // chunks beyond the end of bytes are left out, isDracoFile only reads up to the end of the JSON
+    const qsizetype end = std::min<qsizetype>(header.length, bytes.size());
+    qsizetype offset = sizeof(header);
+    bool hasJson = false;
+    while (offset + static_cast<qsizetype>(sizeof(GlbChunkHeader)) <= end) {
+        GlbChunkHeader chunk{};
+        std::memcpy(&chunk, bytes.constData() + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk.length > end - offset) {
+            break;
+        }
+        if (chunk.type == GLB_CHUNK_JSON && !hasJson) {
+            const auto document = QJsonDocument::fromJson(bytes.mid(offset, chunk.length));
+            json = document.object();
+            hasJson = document.isObject();
+        } else if (chunk.type == GLB_CHUNK_BIN && bin.data == nullptr) {
+            bin = {bytes.constData() + offset, static_cast<qsizetype>(chunk.length)};
+        }
+        offset += chunk.length;
+    }
+    return hasJson;
+}
+
+bool requiresDraco(const QJsonObject &json) {
+    return json.value("extensionsRequired").toArray().contains(KHR_DRACO);
+}
+
+// array of raw pointers as aiScene keeps them
+template<typename T>
+T **releaseAll(std::vector<std::unique_ptr<T>> &owned) {
+    auto **raw = new T *[owned.size()];
+    for (size_t i = 0; i < owned.size(); ++i) {
+        raw[i] = owned[i].release();
+    }
+    return raw;
+}
+
+void appendPadded(QByteArray &out, const char *data, const qsizetype size, const char padding) {
+    out.append(data, size);
+    out.append((4 - out.size() % 4) % 4, padding);
+}
+}
+
+bool DracoPackage::isDracoFile(const QString &path) {
+    const auto suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == QLatin1String("drc")) {
+        return true;
+    }
+    if (suffix != QLatin1String("glb") && suffix != QLatin1String("gltf")) {
+        return false;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (suffix == QLatin1String("gltf")) {
+        return requiresDraco(QJsonDocument::fromJson(file.readAll()).object());
+    }
+    // only the JSON chunk, always the first one
+    const auto header = file.read(sizeof(GlbHeader) + sizeof(GlbChunkHeader));
+    if (header.size() != sizeof(GlbHeader) + sizeof(GlbChunkHeader)) {
+        return false;
+    }
+    GlbChunkHeader chunk{};
+    std::memcpy(&chunk, header.constData() + sizeof(GlbHeader), sizeof(chunk));
+    QJsonObject json;
+    Span bin;
+    return parseGlb(header + file.read(chunk.length), json, bin) && requiresDraco(json);
+}
+
+DracoPackage::DracoPackage() = default;
+
+DracoPackage::~DracoPackage() = default;
+
+bool DracoPackage::open(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Error reading Draco file: " << path.toStdString() << std::endl;
+        return false;
+    }
+    const auto bytes = file.readAll();
+    return QFileInfo(path).suffix().toLower() == QLatin1String("drc") ? openDrc(bytes) : openGltf(path, bytes);
+}
+
+bool DracoPackage::openDrc(const QByteArray &bytes) {
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    const auto decoded = decodeMesh({bytes.constData(), bytes.size()});
+    if (!decoded) {
+        return false;
+    }
+    std::unique_ptr<aiMesh> mesh(toAiMesh(*decoded, {}, 0, false));
+    m_decodeMillis = decodeTimer.nsecsElapsed() / 1e6;
+    if (!mesh) {
+        return false;
+    }
+
+    m_scene = std::make_unique<aiScene>();
+    m_scene->mNumMeshes = 1;
+    m_scene->mMeshes = new aiMesh *[1]{mesh.release()};
+    // a single untextured material
+    m_scene->mNumMaterials = 1;
+    m_scene->mMaterials = new aiMaterial *[1]{new aiMaterial()};
+    m_scene->mRootNode = new aiNode("drc");
+    return true;
+}
+
+bool DracoPackage::openGltf(const QString &path, const QByteArray &bytes) {
+    QJsonObject json;
+    Span glbBin;
+    if (QFileInfo(path).suffix().toLower() == QLatin1String("glb")) {
+        if (!parseGlb(bytes, json, glbBin)) {
+            std::cerr << "Error reading glTF: " << path.toStdString() << std::endl;
+            return false;
+        }
+    } else {
+        json = QJsonDocument::fromJson(bytes).object();
+    }
+
+    // buffer 0 of a .glb is its BIN chunk, everything else is a data URI or a file next to the glTF
+    const auto loadUri = [&](const QString &uri, QByteArray &out) {
+        if (uri.startsWith(QLatin1String("data:"))) {
+            out = QByteArray::fromBase64(uri.section(QLatin1Char(','), 1).toLatin1());
+            return true;
+        }
+        QFile uriFile(QFileInfo(path).dir().filePath(uri));
+        if (!uriFile.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        out = uriFile.readAll();
+        return true;
+    };
+    const auto buffersJson = json.value("buffers").toArray();
+    std::vector<QByteArray> externalBuffers(buffersJson.size());
+    std::vector<Span> buffers(buffersJson.size());
+    for (qsizetype i = 0; i < buffersJson.size(); ++i) {
+        const auto uri = buffersJson[i].toObject().value("uri").toString();
+        if (i == 0 && uri.isEmpty() && glbBin.data != nullptr) {
+            buffers[i] = glbBin;
+        } else if (loadUri(uri, externalBuffers[i])) {
+            buffers[i] = {externalBuffers[i].constData(), externalBuffers[i].size()};
+        } else {
+            std::cerr << "Error reading glTF buffer: " << uri.toStdString() << std::endl;
+            return false;
+        }
+    }
+    const auto bufferViewsJson = json.value("bufferViews").toArray();
+    const auto bufferView = [&](const int index, Span &out) {
+        if (index < 0 || index >= bufferViewsJson.size()) {
+            return false;
+        }
+        const auto view = bufferViewsJson[index].toObject();
+        const int buffer = view.value("buffer").toInt(-1);
+        if (buffer < 0 || buffer >= static_cast<int>(buffers.size())) {
+            return false;
+        }
+        // compared as doubles, before converting them, and without adding them up
+        const double offset = view.value("byteOffset").toDouble(0);
+        const double length = view.value("byteLength").toDouble(0);
+        const auto size = static_cast<double>(buffers[buffer].size);
+        if (!(offset >= 0 && length >= 0 && offset <= size && length <= size - offset)) {
+            return false;
+        }
+        out = {buffers[buffer].data + static_cast<qsizetype>(offset), static_cast<qsizetype>(length)};
+        return true;
+    };
+
+    // embedded images, in the order materials first refer to them
+    const auto texturesJson = json.value("textures").toArray();
+    const auto imagesJson = json.value("images").toArray();
+    std::vector<std::unique_ptr<aiTexture>> textures;
+    std::map<int, unsigned int> imageToTexture;
+    const auto embedImage = [&](const int textureIndex) -> int {
+        const int image = texturesJson[textureIndex].toObject().value("source").toInt(-1);
+        if (image < 0 || image >= imagesJson.size()) {
+            return -1;
+        }
+        if (const auto known = imageToTexture.find(image); known != imageToTexture.end()) {
+            return static_cast<int>(known->second);
+        }
+        const auto imageJson = imagesJson[image].toObject();
+        QByteArray uriBytes;
+        Span data;
+        if (imageJson.contains("bufferView")) {
+            if (!bufferView(imageJson.value("bufferView").toInt(-1), data)) {
+                return -1;
+            }
+        } else if (loadUri(imageJson.value("uri").toString(), uriBytes)) {
+            data = {uriBytes.constData(), uriBytes.size()};
+        } else {
+            return -1;
+        }
+
+        // compressed as it is, decoded later like any other embedded texture
+        auto texture = std::make_unique<aiTexture>();
+        texture->mWidth = static_cast<unsigned int>(data.size);
+        texture->mHeight = 0;
+        texture->pcData = new aiTexel[(data.size + sizeof(aiTexel) - 1) / sizeof(aiTexel)];
+        std::memcpy(texture->pcData, data.data, data.size);
+        auto format = imageJson.value("mimeType").toString().section(QLatin1Char('/'), 1).toStdString();
+        if (format == "jpeg") {
+            format = "jpg";
+        }
+        std::strncpy(texture->achFormatHint, format.c_str(), HINTMAXTEXTURELEN - 1);
+        imageToTexture[image] = static_cast<unsigned int>(textures.size());
+        textures.push_back(std::move(texture));
+        return static_cast<int>(textures.size()) - 1;
+    };
+
+    // primitives without a material get one of their own at the end
+    const auto materialsJson = json.value("materials").toArray();
+    std::vector<std::unique_ptr<aiMaterial>> materials;
+    for (const auto &materialValue: materialsJson) {
+        const auto materialJson = materialValue.toObject();
+        auto &material = materials.emplace_back(std::make_unique<aiMaterial>());
+        const aiString name(materialJson.value("name").toString().toStdString());
+        material->AddProperty(&name, AI_MATKEY_NAME);
+
+        const auto pbr = materialJson.value("pbrMetallicRoughness").toObject();
+        const auto baseColor = pbr.value("baseColorTexture").toObject();
+        if (baseColor.contains("index")) {
+            const int textureIndex = baseColor.value("index").toInt(-1);
+            const int embedded = textureIndex >= 0 && textureIndex < texturesJson.size() ? embedImage(textureIndex) : -1;
+            if (embedded < 0) {
+                std::cerr << "Error reading glTF texture of material " << materials.size() - 1 << std::endl;
+                return false;
+            }
+            const aiString texturePath("*" + std::to_string(embedded));
+            material->AddProperty(&texturePath, AI_MATKEY_TEXTURE_DIFFUSE(0));
+        }
+    }
+    const auto defaultMaterial = static_cast<unsigned int>(materials.size());
+
+    struct Primitive {
+        Span draco;
+        DracoAttributes attributes;
+        unsigned int materialIndex;
+    };
+    std::vector<Primitive> primitives;
+    bool usesDefaultMaterial = false;
+    for (const auto &meshValue: json.value("meshes").toArray()) {
+        for (const auto &primitiveValue: meshValue.toObject().value("primitives").toArray()) {
+            const auto primitiveJson = primitiveValue.toObject();
+            const auto extension = primitiveJson.value("extensions").toObject().value(KHR_DRACO).toObject();
+            Primitive primitive;
+            if (primitiveJson.value("mode").toInt(GLTF_TRIANGLES) != GLTF_TRIANGLES || extension.isEmpty() ||
+                !bufferView(extension.value("bufferView").toInt(-1), primitive.draco)) {
+                std::cerr << "Error reading glTF: every primitive has to be Draco-compressed triangles" << std::endl;
+                return false;
+            }
+            const auto attributes = extension.value("attributes").toObject();
+            primitive.attributes.position = attributes.value("POSITION").toInt(-1);
+            primitive.attributes.normal = attributes.value("NORMAL").toInt(-1);
+            primitive.attributes.texCoord = attributes.value("TEXCOORD_0").toInt(-1);
+            const int material = primitiveJson.value("material").toInt(-1);
+            if (material >= 0 && material < static_cast<int>(defaultMaterial)) {
+                primitive.materialIndex = material;
+            } else {
+                primitive.materialIndex = defaultMaterial;
+                usesDefaultMaterial = true;
+            }
+            primitives.push_back(primitive);
+        }
+    }
+    if (usesDefaultMaterial || materials.empty()) {
+        materials.push_back(std::make_unique<aiMaterial>());
+    }
+
+    // every primitive is an independent bitstream
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    std::vector<std::unique_ptr<aiMesh>> meshes(primitives.size());
+    parallelFor(primitives.size(), [&](const size_t i) {
+        const auto decoded = decodeMesh(primitives[i].draco);
+        if (decoded) {
+            meshes[i].reset(toAiMesh(*decoded, primitives[i].attributes, primitives[i].materialIndex, true));
+        }
+    });
+    m_decodeMillis = decodeTimer.nsecsElapsed() / 1e6;
+
+    if (std::find(meshes.begin(), meshes.end(), nullptr) != meshes.end()) {
+        return false;
+    }
+
+    // the scene takes over everything, as assimp's own importers hand it over
+    m_scene = std::make_unique<aiScene>();
+    m_scene->mNumMeshes = static_cast<unsigned int>(meshes.size());
+    m_scene->mMeshes = releaseAll(meshes);
+    m_scene->mNumMaterials = static_cast<unsigned int>(materials.size());
+    m_scene->mMaterials = releaseAll(materials);
+    m_scene->mNumTextures = static_cast<unsigned int>(textures.size());
+    m_scene->mTextures = releaseAll(textures);
+    m_scene->mRootNode = new aiNode("glTF");
+    return true;
+}
+
+QByteArray DracoPackage::encodeDrc(const aiScene &scene, const DracoEncodeOptions &options) {
+    if (scene.mNumMeshes == 0) {
+        return {};
+    }
+    DracoAttributes ids;
+    const auto mesh = toDracoMesh(*scene.mMeshes[0], false, ids);
+    return encodeMesh(*mesh, options);
+}
+
+QByteArray DracoPackage::encodeGlb(const aiScene &scene, const DracoEncodeOptions &options) {
+    // what the accessors need to know about every mesh, read back from the decoded bitstream:
+    // edgebreaker may add points, and quantization moves the bounds
+    struct EncodedMesh {
+        QByteArray bytes;
+        DracoAttributes ids;
+        unsigned int pointCount = 0;
+        unsigned int faceCount = 0;
+        float min[3] = {};
+        float max[3] = {};
+    };
+    std::vector<EncodedMesh> encoded(scene.mNumMeshes);
+    parallelFor(scene.mNumMeshes, [&](const size_t i) {
+        auto &out = encoded[i];
+        const auto mesh = toDracoMesh(*scene.mMeshes[i], true, out.ids);
+        out.bytes = encodeMesh(*mesh, options);
+        const auto decoded = out.bytes.isEmpty() ? nullptr : decodeMesh({out.bytes.constData(), out.bytes.size()});
+        if (!decoded) {
+            out.bytes.clear();
+            return;
+        }
+        out.pointCount = decoded->num_points();
+        out.faceCount = decoded->num_faces();
+        const auto *position = decoded->GetAttributeByUniqueId(out.ids.position);
+        if (position == nullptr) {
+            out.bytes.clear();
+            return;
+        }
+        std::fill(std::begin(out.min), std::end(out.min), std::numeric_limits<float>::max());
+        std::fill(std::begin(out.max), std::end(out.max), std::numeric_limits<float>::lowest());
+        for (draco::AttributeValueIndex v(0); v < position->size(); ++v) {
+            float value[3];
+            position->ConvertValue<float>(v, 3, value);
+            for (int axis = 0; axis < 3; ++axis) {
+                out.min[axis] = std::min(out.min[axis], value[axis]);
+                out.max[axis] = std::max(out.max[axis], value[axis]);
+            }
+        }
+    });
+    for (const auto &mesh: encoded) {
+        if (mesh.bytes.isEmpty()) {
+            return {};
+        }
+    }
+
+    QByteArray bin;
+    QJsonArray bufferViews;
+    const auto addBufferView = [&](const char *data, const qsizetype size) {
+        bufferViews.append(QJsonObject{{"buffer", 0}, {"byteOffset", bin.size()}, {"byteLength", size}});
+        appendPadded(bin, data, size, '\0');
+        return bufferViews.size() - 1;
+    };
+
+    QJsonArray accessors;
+    const auto addAccessor = [&](const unsigned int count, const int componentType, const char *type) {
+        accessors.append(QJsonObject{{"count", static_cast<qint64>(count)}, {"componentType", componentType},
+                                     {"type", type}});
+        return accessors.size() - 1;
+    };
+
+    QJsonArray meshes;
+    QJsonArray nodes;
+    QJsonArray sceneNodes;
+    for (unsigned int i = 0; i < scene.mNumMeshes; ++i) {
+        const auto &mesh = encoded[i];
+        QJsonObject attributes;
+        QJsonObject dracoAttributes;
+        const auto positionAccessor = addAccessor(mesh.pointCount, GLTF_FLOAT, "VEC3");
+        auto positionJson = accessors[positionAccessor].toObject();
+        positionJson["min"] = QJsonArray{mesh.min[0], mesh.min[1], mesh.min[2]};
+        positionJson["max"] = QJsonArray{mesh.max[0], mesh.max[1], mesh.max[2]};
+        accessors[positionAccessor] = positionJson;
+        attributes["POSITION"] = positionAccessor;
+        dracoAttributes["POSITION"] = mesh.ids.position;
+        if (mesh.ids.normal >= 0) {
+            attributes["NORMAL"] = addAccessor(mesh.pointCount, GLTF_FLOAT, "VEC3");
+            dracoAttributes["NORMAL"] = mesh.ids.normal;
+        }
+        if (mesh.ids.texCoord >= 0) {
+            attributes["TEXCOORD_0"] = addAccessor(mesh.pointCount, GLTF_FLOAT, "VEC2");
+            dracoAttributes["TEXCOORD_0"] = mesh.ids.texCoord;
+        }
+
+        const QJsonObject primitive{
+            {"attributes", attributes},
+            {"indices", addAccessor(mesh.faceCount * 3, GLTF_UNSIGNED_INT, "SCALAR")},
+            {"material", static_cast<qint64>(scene.mMeshes[i]->mMaterialIndex)},
+            {"mode", GLTF_TRIANGLES},
+            {"extensions", QJsonObject{{KHR_DRACO, QJsonObject{
+                {"bufferView", addBufferView(mesh.bytes.constData(), mesh.bytes.size())},
+                {"attributes", dracoAttributes}
+            }}}},
+        };
+        meshes.append(QJsonObject{{"name", scene.mMeshes[i]->mName.C_Str()}, {"primitives", QJsonArray{primitive}}});
+        nodes.append(QJsonObject{{"mesh", static_cast<qint64>(i)}});
+        sceneNodes.append(static_cast<qint64>(i));
+    }
+
+    // embedded diffuse textures stay in the format they came in, non-standard mime types for anything but png and jpeg
+    QJsonArray materials;
+    QJsonArray textures;
+    QJsonArray images;
+    std::map<int, qsizetype> embeddedToTexture;
+    for (unsigned int i = 0; i < scene.mNumMaterials; ++i) {
+        const auto &material = *scene.mMaterials[i];
+        QJsonObject pbr{{"metallicFactor", 0.0}};
+        aiString texturePath;
+        if (material.GetTextureCount(aiTextureType_DIFFUSE) > 0 &&
+            material.GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS) {
+            const auto [embedded, embeddedIndex] = scene.GetEmbeddedTextureAndIndex(texturePath.C_Str());
+            if (embedded == nullptr || embedded->mHeight != 0) {
+                std::cerr << "Only compressed embedded textures can be packaged: " << texturePath.C_Str() << std::endl;
+                return {};
+            }
+            if (!embeddedToTexture.count(embeddedIndex)) {
+                auto format = QString::fromLatin1(embedded->achFormatHint).toLower();
+                if (format == QLatin1String("jpg")) {
+                    format = QStringLiteral("jpeg");
+                }
+                images.append(QJsonObject{
+                    {"bufferView", addBufferView(reinterpret_cast<const char *>(embedded->pcData), embedded->mWidth)},
+                    {"mimeType", QStringLiteral("image/") + format},
+                });
+                textures.append(QJsonObject{{"source", images.size() - 1}});
+                embeddedToTexture[embeddedIndex] = textures.size() - 1;
+            }
+            pbr["baseColorTexture"] = QJsonObject{{"index", embeddedToTexture[embeddedIndex]}};
+        }
+        aiString name;
+        material.Get(AI_MATKEY_NAME, name);
+        materials.append(QJsonObject{{"name", name.C_Str()}, {"pbrMetallicRoughness", pbr}});
+    }
+
+    QJsonObject json{
+        {"asset", QJsonObject{{"version", "2.0"}, {"generator", "inner_ear_vis_convert"}}},
+        {"extensionsUsed", QJsonArray{KHR_DRACO}},
+        {"extensionsRequired", QJsonArray{KHR_DRACO}},
+        {"scene", 0},
+        {"scenes", QJsonArray{QJsonObject{{"nodes", sceneNodes}}}},
+        {"nodes", nodes},
+        {"meshes", meshes},
+        {"materials", materials},
+        {"accessors", accessors},
+        {"bufferViews", bufferViews},
+        {"buffers", QJsonArray{QJsonObject{{"byteLength", bin.size()}}}},
+    };
+    if (!images.isEmpty()) {
+        json["textures"] = textures;
+        json["images"] = images;
+    }
+
+    QByteArray jsonChunk;
+    const auto jsonBytes = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    appendPadded(jsonChunk, jsonBytes.constData(), jsonBytes.size(), ' ');
+
+    QByteArray glb;
+    const GlbHeader header{
+        GLB_MAGIC, GLB_VERSION,
+        static_cast<quint32>(sizeof(GlbHeader) + 2 * sizeof(GlbChunkHeader) + jsonChunk.size() + bin.size())
+    };
+    const GlbChunkHeader jsonHeader{static_cast<quint32>(jsonChunk.size()), GLB_CHUNK_JSON};
+    const GlbChunkHeader binHeader{static_cast<quint32>(bin.size()), GLB_CHUNK_BIN};
+    glb.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    glb.append(reinterpret_cast<const char *>(&jsonHeader), sizeof(jsonHeader));
+    glb.append(jsonChunk);
+    glb.append(reinterpret_cast<const char *>(&binHeader), sizeof(binHeader));
+    glb.append(bin);
+    return glb;
+}
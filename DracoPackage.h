@@ -0,0 +1,58 @@
+#ifndef DRACOPACKAGE_H
+#define DRACOPACKAGE_H
+#include <memory>
+#include <QByteArray>
+#include <QString>
+
+struct aiScene;
+
+// quantization and speed of the Draco encoder, see inner_ear_vis_convert
+struct DracoEncodeOptions {
+    int positionBits = 14;
+    int normalBits = 10;
+    int texCoordBits = 12;
+    // 0 compresses best, 10 encodes and decodes fastest
+    int speed = 5;
+};
+
+// Draco-compressed meshes, either a standalone .drc file holding a single mesh or glTF 2.0 (.glb, .gltf) with every
+// primitive compressed with KHR_draco_mesh_compression and the material textures embedded. The meshes are decoded
+// on all cores into an assimp scene, so everything after the import is the same as for models assimp reads.
+// Node transforms are ignored, as they are for the FBX.
+class DracoPackage {
+public:
+    // .drc, or glTF requiring KHR_draco_mesh_compression. glTF files only using it optionally are left to assimp
+    static bool isDracoFile(const QString &path);
+
+    // one KHR_draco_mesh_compression primitive per mesh, embedded textures are stored as they are.
+    // Empty on error (a mesh without triangles, an encoder failure)
+    static QByteArray encodeGlb(const aiScene &scene, const DracoEncodeOptions &options);
+    // the first mesh of the scene as a standalone Draco bitstream
+    static QByteArray encodeDrc(const aiScene &scene, const DracoEncodeOptions &options);
+
+    DracoPackage();
+    ~DracoPackage();
+
+    // decodes every mesh, false (after printing why) when the file is damaged or not Draco-compressed throughout
+    bool open(const QString &path);
+
+    // owned by the package, valid until it is destroyed
+    const aiScene *scene() const {
+        return m_scene.get();
+    }
+
+    // spent decoding meshes, wall clock over all threads
+    double decodeMillis() const {
+        return m_decodeMillis;
+    }
+
+private:
+    bool openDrc(const QByteArray &bytes);
+    bool openGltf(const QString &path, const QByteArray &bytes);
+
+    std::unique_ptr<aiScene> m_scene;
+    double m_decodeMillis = 0.0;
+};
+
+
+#endif //DRACOPACKAGE_H
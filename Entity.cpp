@@ -4,77 +4,43 @@
 
 #include "Entity.h"
 
-#include <iostream>
-
-#include "assimp/material.h"
-
-Entity::Entity(const aiMesh &mesh, QRhiTexture* texture, QRhiSampler* sampler, QRhi& rhi, QRhiResourceUpdateBatch *initialUpdates, QRhiBuffer* ubuf, QRhiBuffer* greyedOutUbuf) {
-
-    constexpr auto positionSize = 3;
-    constexpr auto normalSize = 3;
-    constexpr auto textureCoords = 2;
-    constexpr auto stride = positionSize + normalSize + textureCoords;
-
-    m_numVertices = mesh.mNumVertices;
-
-    auto *vertexData = new float[mesh.mNumVertices * stride];
-
-    m_vertices.reserve(m_numVertices);
-
-    for (int i = 0; i < mesh.mNumVertices; ++i) {
-        const auto v = mesh.mVertices[i];
-        const auto n = mesh.mNormals[i];
-        const auto t = mesh.mTextureCoords[0][i];
-
-        // poor man scaling :)
-        float x = v.x / 1000.0f;
-        float y = v.y / 1000.0f;
-        float z = v.z / 1000.0f;
-
-        vertexData[stride * i] = x;
-        vertexData[stride * i + 1] = y;
-        vertexData[stride * i + 2] = z;
+Entity::Entity(const CachedMesh &mesh, const DrawRange drawRange, const int textureLayer)
+    : m_drawRange(drawRange), m_textureLayer(textureLayer), m_materialIndex(mesh.materialIndex) {
+    m_centroid = mesh.centroid;
+    m_picking = mesh.picking;
+    m_dequantization = mesh.dequantization;
+
+    const auto bounds = m_picking->bounds();
+    m_boundsCenter = bounds.centroid();
+    m_boundsRadius = m_picking->positions().empty() ? 0.0f : (bounds.max - bounds.min).length() * 0.5f;
+}
 
-        vertexData[stride * i + 3] = n.x;
-        vertexData[stride * i + 4] = n.y;
-        vertexData[stride * i + 5] = n.z;
+unsigned int Entity::GetNumVertices() const {
+    return m_drawRange.vertexCount;
+}
 
-        vertexData[stride * i + 6] = t.x;
-        vertexData[stride * i + 7] = 1.0f - t.y;  // flipping the y coordinate for pipeline to handle properly
+unsigned int Entity::GetNumIndices() const {
+    return m_drawRange.lods.empty() ? 0 : m_drawRange.lods.front().indexCount;
+}
 
-        // also copy vertex positions for later use, eg. raycasting
-        m_vertices.emplace_back(x, y, z);
+const IndexRange &Entity::lodForScreenDiameter(const float pixels) const {
+    // finer than a triangle every few pixels is not visible, only paid for
+    constexpr float PIXELS_PER_TRIANGLE = 4.0f;
+    // area of the disc the sphere projects to
+    const float wantedTriangles = 0.785f * pixels * pixels / PIXELS_PER_TRIANGLE;
 
-        // computing centroid for zooming on selection
-        m_centroid += QVector3D(x, y, z);
+    for (auto lod = m_drawRange.lods.rbegin(); lod != m_drawRange.lods.rend(); ++lod) {
+        if (lod->indexCount / 3.0f >= wantedTriangles) {
+            return *lod;
+        }
     }
-
-    m_vbuf.reset(rhi.newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer,
-                                  mesh.mNumVertices * stride * sizeof(float)));
-    m_vbuf->create();
-    initialUpdates->uploadStaticBuffer(m_vbuf.get(), vertexData);
-
-    static constexpr QRhiShaderResourceBinding::StageFlags visibility =
-            QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage;
-
-    m_defaultSrb.reset(rhi.newShaderResourceBindings());
-    m_defaultSrb->setBindings({
-        QRhiShaderResourceBinding::uniformBuffer(0, visibility, ubuf),
-        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
-                                                  texture, sampler)
-    });
-    m_defaultSrb->create();
-    m_greyedOutSrb.reset(rhi.newShaderResourceBindings());
-    m_greyedOutSrb->setBindings({
-        QRhiShaderResourceBinding::uniformBuffer(0, visibility, greyedOutUbuf),
-        QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
-                                                  texture, sampler)
-    });
-    m_greyedOutSrb->create();
-
-    m_centroid /= static_cast<float>(mesh.mNumVertices);
+    return m_drawRange.lods.front();
 }
 
-unsigned int Entity::GetNumVertices() const {
-    return m_numVertices;
+EntityMemory Entity::memory(const quint32 indexSize) const {
+    EntityMemory memory;
+    memory.gpuVertexBytes = static_cast<quint64>(m_drawRange.vertexCount) * sizeof(QuantizedVertex);
+    memory.gpuIndexBytes = static_cast<quint64>(m_drawRange.indexCount) * indexSize;
+    memory.cpuPickingBytes = m_picking ? m_picking->memoryBytes() : 0;
+    return memory;
 }
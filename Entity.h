@@ -1,31 +1,75 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 #include <memory>
-#include <rhi/qrhi.h>
 
-#include "assimp/mesh.h"
+#include "MeshCache.h"
+#include "Picking.h"
+#include "SceneGeometry.h"
 #include <cstdint>
 
+// of an entity, and of a whole specimen in the comparison view (see InstanceData)
 enum class RenderingMode : int {
     Normal = 0,
     GreyedOut = 1
 };
 
+// what one entity keeps alive, for the stats overlay
+struct EntityMemory {
+    quint64 gpuVertexBytes = 0;
+    // every level of detail
+    quint64 gpuIndexBytes = 0;
+    quint64 cpuPickingBytes = 0;
+};
+
+// per draw block of the dynamic uniform buffer, std140
+struct EntityUniforms {
+    qint32 renderingMode;
+    float opacity;
+    // layer of the material texture array, -1 when the material has no texture
+    qint32 textureLayer;
+    // under the mouse cursor, lit up in the hovered specimen only
+    qint32 hovered;
+    // of the quantized positions, w unused, see PositionDequantization
+    float positionOffset[4];
+    float positionScale[4];
+};
+
+// per instance vertex data of the color pipeline, one specimen of the comparison view
+struct InstanceData {
+    // column major, placed in the grid after the model rotation
+    float transform[16];
+    // greyed out while a part of another specimen is selected
+    qint32 renderingMode;
+    qint32 hovered;
+    qint32 padding[2];
+};
+
 class Entity {
 public:
-    Entity(const aiMesh &mesh, QRhiTexture* texture, QRhiSampler* sampler, QRhi& rhi, QRhiResourceUpdateBatch *initialUpdates, QRhiBuffer* ubuf, QRhiBuffer* greyedOutUbuf);
+    Entity(const CachedMesh &mesh, DrawRange drawRange, int textureLayer);
 
     unsigned int GetNumVertices() const;
+    // at full detail
+    unsigned int GetNumIndices() const;
+    // coarsest level of detail that still has enough triangles for the pixels its bounding sphere covers
+    const IndexRange &lodForScreenDiameter(float pixels) const;
+    // indexSize is 2 or 4, as the shared index buffer is laid out
+    EntityMemory memory(quint32 indexSize) const;
 
-    std::unique_ptr<QRhiShaderResourceBindings> m_defaultSrb;
-    std::unique_ptr<QRhiShaderResourceBindings> m_greyedOutSrb;
-    std::unique_ptr<QRhiBuffer> m_vbuf;
-    std::vector<QVector3D> m_vertices;
+    // geometry lives in the SceneGeometry buffers, shared by every entity
+    DrawRange m_drawRange;
+    int m_textureLayer;
+    unsigned int m_materialIndex;
+    // shared with the picking thread, see PickingScene
+    std::shared_ptr<const PickingGeometry> m_picking;
     QVector3D m_centroid;
+    // maps the quantized positions of the mesh to model space
+    PositionDequantization m_dequantization;
+    // bounding sphere in model space, for picking the level of detail
+    QVector3D m_boundsCenter;
+    float m_boundsRadius = 0.0f;
     float m_opacity = 1.0f;
     RenderingMode m_renderingMode = RenderingMode::Normal;
-private:
-    unsigned int m_numVertices;
 };
 
 
@@ -0,0 +1,94 @@
+#include "MappedIOSystem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <QFile>
+#include <assimp/IOStream.hpp>
+
+namespace {
+class MappedIOStream : public Assimp::IOStream {
+public:
+    // false when the file cannot be opened or mapped
+    bool open(const QString &path) {
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::ReadOnly) || m_file.size() == 0) {
+            return false;
+        }
+        m_size = static_cast<size_t>(m_file.size());
+        m_data = m_file.map(0, m_file.size());
+        return m_data != nullptr;
+    }
+
+    size_t Read(void *buffer, const size_t size, const size_t count) override {
+        if (size == 0) {
+            return 0;
+        }
+        const size_t read = std::min(count, (m_size - m_position) / size);
+        std::memcpy(buffer, m_data + m_position, read * size);
+        m_position += read * size;
+        return read;
+    }
+
+    size_t Write(const void *, size_t, size_t) override {
+        return 0;
+    }
+
+    // the offset counts back from the end for aiOrigin_END, as for assimp's MemoryIOStream
+    aiReturn Seek(const size_t offset, const aiOrigin origin) override {
+        size_t position;
+        switch (origin) {
+            case aiOrigin_SET:
+                position = offset;
+                break;
+            case aiOrigin_END:
+                if (offset > m_size) {
+                    return AI_FAILURE;
+                }
+                position = m_size - offset;
+                break;
+            default:
+                position = m_position + offset;
+                break;
+        }
+        if (position > m_size) {
+            return AI_FAILURE;
+        }
+        m_position = position;
+        return AI_SUCCESS;
+    }
+
+    size_t Tell() const override {
+        return m_position;
+    }
+
+    size_t FileSize() const override {
+        return m_size;
+    }
+
+    void Flush() override {
+    }
+
+    const void *MappedData() const override {
+        return m_data;
+    }
+
+private:
+    // unmapped when closed
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_position = 0;
+};
+}
+
+Assimp::IOStream *MappedIOSystem::Open(const char *file, const char *mode) {
+    // writers and anything else but plain reads go through the default streams
+    if (std::strchr(mode, 'r') && !std::strchr(mode, '+')) {
+        auto *stream = new MappedIOStream;
+        if (stream->open(QString::fromUtf8(file))) {
+            return stream;
+        }
+        delete stream;
+    }
+    return DefaultIOSystem::Open(file, mode);
+}
@@ -0,0 +1,15 @@
+#ifndef MAPPEDIOSYSTEM_H
+#define MAPPEDIOSYSTEM_H
+#include <assimp/DefaultIOSystem.h>
+
+// assimp's default IO system, except that files opened for reading are memory-mapped. Importers reading the whole
+// file (binary FBX and STL) work on the mapped pages in place through IOStream::MappedData instead of copying the
+// file to the heap first, everything else reads from the mapping as it would from the file.
+// Files that cannot be mapped (empty ones, for one) are opened the default way.
+class MappedIOSystem : public Assimp::DefaultIOSystem {
+public:
+    Assimp::IOStream *Open(const char *file, const char *mode) override;
+};
+
+
+#endif //MAPPEDIOSYSTEM_H
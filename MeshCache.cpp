@@ -0,0 +1,520 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include "Simplifier.h"
+#include "assimp/scene.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "vendor/stb_image.h"
+
+namespace {
+constexpr char MAGIC[4] = {'I', 'E', 'M', 'C'};
+// bump on any change to the records below, to BvhNode or to QuantizedVertex
+constexpr quint32 FORMAT_VERSION = 5;
+// written in native byte order, a cache from a machine of the other endianness reads back differently
+constexpr quint32 BYTE_ORDER_MARK = 0x01020304;
+constexpr qint64 BLOB_ALIGNMENT = 16;
+constexpr int SOURCE_HASH_SIZE = 32;
+
+struct FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 importFlags;
+    char sourceHash[SOURCE_HASH_SIZE];
+    quint32 textureCount;
+    quint32 meshCount;
+    quint64 totalSize;
+};
+
+// the pixels are in the TextureCache, under the hash of the embedded image
+struct TextureRecord {
+    quint32 materialIndex;
+    quint32 width;
+    quint32 height;
+    quint32 reserved;
+    char hash[SOURCE_HASH_SIZE];
+};
+
+struct MeshRecord {
+    quint32 materialIndex;
+    quint32 vertexCount;
+    float centroid[3];
+    quint32 indexCount;
+    // 2 or 4 bytes
+    quint32 indexSize;
+    quint32 bvhNodeCount;
+    quint64 vertexDataOffset;
+    quint64 indexDataOffset;
+    // 32 bit, in picking hierarchy leaf order
+    quint64 pickingIndicesOffset;
+    quint64 bvhNodesOffset;
+    quint32 lodCount;
+    // the levels follow each other in the index data, together indexCount long
+    quint32 lodIndexCounts[MAX_LOD_COUNT];
+    // see PositionDequantization
+    float positionOffset[3];
+    float positionScale[3];
+    quint32 reserved;
+};
+
+static_assert(sizeof(FileHeader) == 64);
+static_assert(sizeof(TextureRecord) == 48);
+static_assert(sizeof(MeshRecord) == 112);
+static_assert(sizeof(QVector3D) == 3 * sizeof(float));
+
+// returns the offset the blob was written at
+quint64 appendAligned(QByteArray &out, const void *data, const qint64 size) {
+    const qint64 padding = (BLOB_ALIGNMENT - out.size() % BLOB_ALIGNMENT) % BLOB_ALIGNMENT;
+    out.append(padding, '\0');
+    const auto offset = static_cast<quint64>(out.size());
+    out.append(static_cast<const char *>(data), size);
+    return offset;
+}
+
+bool inBounds(const quint64 offset, const quint64 size, const qint64 fileSize) {
+    return offset % BLOB_ALIGNMENT == 0 && offset <= static_cast<quint64>(fileSize) &&
+           size <= static_cast<quint64>(fileSize) - offset;
+}
+
+template<typename Index>
+bool indicesBelow(const uchar *data, const quint64 count, const quint32 vertexCount) {
+    const auto *indices = reinterpret_cast<const Index *>(data);
+    return std::all_of(indices, indices + count, [&](const Index index) { return index < vertexCount; });
+}
+
+template<typename Index>
+quint64 appendIndices(QByteArray &out, const std::vector<uint32_t> &indices) {
+    std::vector<Index> narrowed(indices.begin(), indices.end());
+    return appendAligned(out, narrowed.data(), static_cast<qint64>(narrowed.size() * sizeof(Index)));
+}
+}
+
+CachedMesh PreparedMesh::view() const {
+    return {
+        materialIndex,
+        static_cast<unsigned int>(vertexData.size()),
+        vertexData.data(),
+        dequantization,
+        static_cast<unsigned int>(indices.size()),
+        true,
+        indices.data(),
+        lodIndexCounts,
+        centroid,
+        picking
+    };
+}
+
+QString MeshCache::cachePathFor(const QString &sourcePath) {
+    const auto cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    // models of the same name in different directories get a cache each, the name is kept for finding them
+    const QFileInfo info(sourcePath);
+    const auto canonicalPath = info.canonicalFilePath();
+    const auto path = canonicalPath.isEmpty() ? info.absoluteFilePath() : canonicalPath;
+    const auto pathHash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha256).toHex().left(16);
+    return QDir(cacheDir).filePath(info.fileName() + QLatin1Char('-') + QString::fromLatin1(pathHash) +
+                                   QLatin1String(".meshcache"));
+}
+
+QByteArray MeshCache::hashSourceFile(const QString &sourcePath) {
+    QFile file(sourcePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) {
+        return {};
+    }
+    return hash.result();
+}
+
+bool MeshCache::findTextures(const aiScene &scene, std::vector<TextureSource> &textures) {
+    for (unsigned int i = 0; i < scene.mNumMaterials; i++) {
+        const aiMaterial *material = scene.mMaterials[i];
+
+        if (material->GetTextureCount(aiTextureType_DIFFUSE) <= 0) {
+            std::cout << "Texture count 0 or less. Skipping..." << std::endl;
+            continue;
+        }
+
+        aiString str;
+        if (material->GetTexture(aiTextureType_DIFFUSE, 0, &str) != AI_SUCCESS) {
+            std::cerr << "Error loading texture: " << str.C_Str() << std::endl;
+            return false;
+        }
+
+        const aiTexture *a_texture = scene.GetEmbeddedTexture(str.C_Str());
+
+        if (a_texture == nullptr) {
+            std::cerr << "Error loading texture: " << str.C_Str() << std::endl;
+            return false;
+        }
+
+        std::cout << "Texture path: " << str.C_Str() << std::endl;
+
+        // only the image header is read here, decoding is left to TextureCache::encode
+        int width, height, channels;
+        if (!stbi_info_from_memory(reinterpret_cast<unsigned char *>(a_texture->pcData), a_texture->mWidth,
+                                   &width, &height, &channels)) {
+            std::cerr << "Error loading texture: " << str.C_Str() << std::endl;
+            return false;
+        }
+
+        textures.push_back({i, a_texture, width, height, TextureCache::hashEmbedded(*a_texture)});
+    }
+    return true;
+}
+
+unsigned int MeshCache::triangleIndexCount(const aiMesh &mesh) {
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < mesh.mNumFaces; ++i) {
+        if (mesh.mFaces[i].mNumIndices == 3) {
+            count += 3;
+        }
+    }
+    return count;
+}
+
+unsigned int MeshCache::indexCapacity(const aiMesh &mesh) {
+    const auto fullIndexCount = triangleIndexCount(mesh);
+    unsigned int capacity = fullIndexCount;
+    for (int level = 1; level < MAX_LOD_COUNT; ++level) {
+        capacity += lodIndexBudget(fullIndexCount, level);
+    }
+    return capacity;
+}
+
+// The mesh is expected to be indexed already (aiProcess_JoinIdenticalVertices), only its triangles are kept.
+PreparedMesh MeshCache::prepareMesh(const aiMesh &mesh) {
+    assert(mesh.HasPositions());
+    assert(mesh.HasNormals());
+    assert(mesh.HasTextureCoords(0));
+
+    PreparedMesh prepared;
+    prepared.materialIndex = mesh.mMaterialIndex;
+    // interleaved floats for the simplifier, only their quantized form is kept
+    std::vector<float> vertexData(static_cast<size_t>(mesh.mNumVertices) * VERTEX_STRIDE);
+
+    for (unsigned int i = 0; i < mesh.mNumVertices; ++i) {
+        const auto v = mesh.mVertices[i];
+        const auto n = mesh.mNormals[i];
+        const auto t = mesh.mTextureCoords[0][i];
+
+        // poor man scaling :)
+        float x = v.x / 1000.0f;
+        float y = v.y / 1000.0f;
+        float z = v.z / 1000.0f;
+
+        vertexData[VERTEX_STRIDE * i] = x;
+        vertexData[VERTEX_STRIDE * i + 1] = y;
+        vertexData[VERTEX_STRIDE * i + 2] = z;
+
+        vertexData[VERTEX_STRIDE * i + 3] = n.x;
+        vertexData[VERTEX_STRIDE * i + 4] = n.y;
+        vertexData[VERTEX_STRIDE * i + 5] = n.z;
+
+        vertexData[VERTEX_STRIDE * i + 6] = t.x;
+        vertexData[VERTEX_STRIDE * i + 7] = 1.0f - t.y;  // flipping the y coordinate for pipeline to handle properly
+    }
+
+    // what the quantized format can't hold is replaced, the mesh is drawn either way
+    const size_t sanitized = sanitizeVertices(vertexData.data(), mesh.mNumVertices);
+    if (sanitized > 0) {
+        std::cerr << "Mesh " << mesh.mName.C_Str() << ": replaced non-finite or out of range values of " << sanitized
+                  << " vertices" << std::endl;
+    }
+    if (!quantizeVertices(vertexData.data(), mesh.mNumVertices, prepared.vertexData, prepared.dequantization)) {
+        std::cerr << "Mesh " << mesh.mName.C_Str() << " is past the quantization error bound, drawn anyway"
+                  << std::endl;
+    }
+
+    // also keep vertex positions for later use, eg. raycasting, as they are drawn
+    std::vector<QVector3D> positions;
+    positions.reserve(mesh.mNumVertices);
+    for (const auto &vertex: prepared.vertexData) {
+        positions.push_back(dequantizePosition(vertex, prepared.dequantization));
+    }
+
+    auto &indices = prepared.indices;
+    indices.reserve(triangleIndexCount(mesh));
+    // computing centroid for zooming on selection, over triangle corners like the de-indexed mesh used to
+    QVector3D centroid;
+    for (unsigned int i = 0; i < mesh.mNumFaces; ++i) {
+        const auto &face = mesh.mFaces[i];
+        if (face.mNumIndices != 3) {
+            continue;
+        }
+        for (unsigned int j = 0; j < 3; ++j) {
+            indices.push_back(face.mIndices[j]);
+            centroid += positions[face.mIndices[j]];
+        }
+    }
+    if (!indices.empty()) {
+        prepared.centroid = centroid / static_cast<float>(indices.size());
+    } else if (!positions.empty()) {
+        // points and lines only, no corners to average
+        Aabb bounds;
+        for (const auto &position: positions) {
+            bounds.grow(position);
+        }
+        prepared.centroid = bounds.centroid();
+    }
+
+    prepared.picking = std::make_shared<const PickingGeometry>(std::move(positions), indices);
+
+    // Coarser levels, each simplified from the one before and appended to the index data. A level that cannot get
+    // within its budget (mostly seams and borders) ends the chain, the coarsest level before it is drawn instead.
+    const auto fullIndexCount = static_cast<uint32_t>(indices.size());
+    prepared.lodIndexCounts.push_back(fullIndexCount);
+    std::vector<uint32_t> previous(indices);
+    for (int level = 1; level < MAX_LOD_COUNT; ++level) {
+        const auto budget = lodIndexBudget(fullIndexCount, level);
+        auto simplified = simplifyMesh(vertexData.data(), mesh.mNumVertices, previous, budget);
+        if (simplified.empty() || simplified.size() > budget) {
+            break;
+        }
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        prepared.lodIndexCounts.push_back(static_cast<unsigned int>(simplified.size()));
+        previous = std::move(simplified);
+    }
+    return prepared;
+}
+
+QByteArray MeshCache::serialize(const QByteArray &sourceHash, const unsigned int importFlags,
+                                const std::vector<TextureSource> &textures,
+                                const std::vector<PreparedMesh> &meshes) {
+    // header and records are filled in once the blob offsets are known
+    const qint64 recordsSize = sizeof(FileHeader) + textures.size() * sizeof(TextureRecord) +
+                               meshes.size() * sizeof(MeshRecord);
+    QByteArray out(recordsSize, '\0');
+
+    std::vector<TextureRecord> textureRecords;
+    for (const auto &texture: textures) {
+        TextureRecord record{};
+        record.materialIndex = texture.materialIndex;
+        record.width = texture.width;
+        record.height = texture.height;
+        std::memcpy(record.hash, texture.hash.constData(), std::min<qsizetype>(texture.hash.size(), SOURCE_HASH_SIZE));
+        textureRecords.push_back(record);
+    }
+
+    std::vector<MeshRecord> meshRecords;
+    for (const auto &mesh: meshes) {
+        const auto vertexCount = static_cast<quint32>(mesh.vertexData.size());
+        const bool indices32Bit = vertexCount > std::numeric_limits<quint16>::max() + 1u;
+
+        MeshRecord record{};
+        record.materialIndex = mesh.materialIndex;
+        record.vertexCount = vertexCount;
+        record.centroid[0] = mesh.centroid.x();
+        record.centroid[1] = mesh.centroid.y();
+        record.centroid[2] = mesh.centroid.z();
+        for (int axis = 0; axis < 3; ++axis) {
+            record.positionOffset[axis] = mesh.dequantization.offset[axis];
+            record.positionScale[axis] = mesh.dequantization.scale[axis];
+        }
+        record.indexCount = static_cast<quint32>(mesh.indices.size());
+        record.lodCount = static_cast<quint32>(mesh.lodIndexCounts.size());
+        std::copy(mesh.lodIndexCounts.begin(), mesh.lodIndexCounts.end(), record.lodIndexCounts);
+        record.indexSize = indices32Bit ? sizeof(quint32) : sizeof(quint16);
+        record.vertexDataOffset = appendAligned(out, mesh.vertexData.data(),
+                                                static_cast<qint64>(mesh.vertexData.size() * sizeof(QuantizedVertex)));
+        record.indexDataOffset = indices32Bit
+                                     ? appendIndices<quint32>(out, mesh.indices)
+                                     : appendIndices<quint16>(out, mesh.indices);
+
+        const auto &picking = *mesh.picking;
+        record.bvhNodeCount = static_cast<quint32>(picking.bvhNodes().size());
+        record.pickingIndicesOffset = appendAligned(out, picking.indices().data(),
+                                                    static_cast<qint64>(picking.indices().size() * sizeof(uint32_t)));
+        record.bvhNodesOffset = appendAligned(out, picking.bvhNodes().data(),
+                                              static_cast<qint64>(picking.bvhNodes().size() * sizeof(BvhNode)));
+        meshRecords.push_back(record);
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.importFlags = importFlags;
+    std::memcpy(header.sourceHash, sourceHash.constData(), std::min<qsizetype>(sourceHash.size(), SOURCE_HASH_SIZE));
+    header.textureCount = static_cast<quint32>(textureRecords.size());
+    header.meshCount = static_cast<quint32>(meshRecords.size());
+    header.totalSize = out.size();
+
+    char *records = out.data();
+    std::memcpy(records, &header, sizeof(header));
+    records += sizeof(header);
+    std::memcpy(records, textureRecords.data(), textureRecords.size() * sizeof(TextureRecord));
+    records += textureRecords.size() * sizeof(TextureRecord);
+    std::memcpy(records, meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+
+    return out;
+}
+
+QByteArray MeshCache::build(const aiScene &scene, const QByteArray &sourceHash, const unsigned int importFlags) {
+    std::vector<TextureSource> sources;
+    if (!findTextures(scene, sources)) {
+        return {};
+    }
+
+    std::vector<PreparedMesh> meshes;
+    meshes.reserve(scene.mNumMeshes);
+    for (unsigned int i = 0; i < scene.mNumMeshes; ++i) {
+        meshes.push_back(prepareMesh(*scene.mMeshes[i]));
+    }
+
+    return serialize(sourceHash, importFlags, sources, meshes);
+}
+
+bool MeshCache::openFile(const QString &cachePath, const QByteArray &sourceHash, const unsigned int importFlags) {
+    m_file.setFileName(cachePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const uchar *mapped = m_file.map(0, m_file.size());
+    if (mapped == nullptr || !parse(mapped, m_file.size(), sourceHash, importFlags)) {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::openBytes(QByteArray bytes, const QByteArray &sourceHash, const unsigned int importFlags) {
+    m_bytes = std::move(bytes);
+    return parse(reinterpret_cast<const uchar *>(m_bytes.constData()), m_bytes.size(), sourceHash, importFlags);
+}
+
+bool MeshCache::parse(const uchar *data, const qint64 size, const QByteArray &sourceHash,
+                      const unsigned int importFlags) {
+    m_textures.clear();
+    m_meshes.clear();
+
+    if (size < static_cast<qint64>(sizeof(FileHeader))) {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+        header.byteOrderMark != BYTE_ORDER_MARK || header.importFlags != importFlags ||
+        header.totalSize != static_cast<quint64>(size) || sourceHash.size() != SOURCE_HASH_SIZE ||
+        std::memcmp(header.sourceHash, sourceHash.constData(), SOURCE_HASH_SIZE) != 0) {
+        return false;
+    }
+
+    const quint64 recordsSize = sizeof(FileHeader) + header.textureCount * sizeof(TextureRecord) +
+                                header.meshCount * static_cast<quint64>(sizeof(MeshRecord));
+    if (recordsSize > static_cast<quint64>(size)) {
+        return false;
+    }
+
+    const auto *textureRecords = reinterpret_cast<const TextureRecord *>(data + sizeof(FileHeader));
+    for (quint32 i = 0; i < header.textureCount; ++i) {
+        const auto &record = textureRecords[i];
+        m_textures.push_back({
+            record.materialIndex,
+            nullptr,
+            static_cast<int>(record.width),
+            static_cast<int>(record.height),
+            QByteArray(record.hash, SOURCE_HASH_SIZE)
+        });
+    }
+
+    const auto *meshRecords = reinterpret_cast<const MeshRecord *>(textureRecords + header.textureCount);
+    for (quint32 i = 0; i < header.meshCount; ++i) {
+        const auto &record = meshRecords[i];
+        if (record.lodCount < 1 || record.lodCount > MAX_LOD_COUNT) {
+            return false;
+        }
+        const std::vector<unsigned int> lodIndexCounts(record.lodIndexCounts, record.lodIndexCounts + record.lodCount);
+        quint64 lodIndexTotal = 0;
+        for (const auto count: lodIndexCounts) {
+            if (count % 3 != 0) {
+                return false;
+            }
+            lodIndexTotal += count;
+        }
+        if (lodIndexTotal != record.indexCount) {
+            return false;
+        }
+
+        const quint64 vertexDataSize = static_cast<quint64>(record.vertexCount) * sizeof(QuantizedVertex);
+        const quint64 indexDataSize = static_cast<quint64>(record.indexCount) * record.indexSize;
+        // picking only ever sees full detail
+        const quint64 pickingIndicesSize = static_cast<quint64>(lodIndexCounts[0]) * sizeof(uint32_t);
+        const quint64 bvhNodesSize = static_cast<quint64>(record.bvhNodeCount) * sizeof(BvhNode);
+        if ((record.indexSize != sizeof(quint16) && record.indexSize != sizeof(quint32)) ||
+            !inBounds(record.vertexDataOffset, vertexDataSize, size) ||
+            !inBounds(record.indexDataOffset, indexDataSize, size) ||
+            !inBounds(record.pickingIndicesOffset, pickingIndicesSize, size) ||
+            !inBounds(record.bvhNodesOffset, bvhNodesSize, size)) {
+            return false;
+        }
+
+        // Past the header checks the body can still be damaged, and bad indices or node ranges would be read out of
+        // bounds by the GPU and the picking traversal. Scanning them costs about as much as dequantizing positions.
+        const bool drawIndicesValid = record.indexSize == sizeof(quint32)
+                                          ? indicesBelow<quint32>(data + record.indexDataOffset, record.indexCount,
+                                                                  record.vertexCount)
+                                          : indicesBelow<quint16>(data + record.indexDataOffset, record.indexCount,
+                                                                  record.vertexCount);
+        if (!drawIndicesValid) {
+            return false;
+        }
+
+        const auto *vertexData = reinterpret_cast<const QuantizedVertex *>(data + record.vertexDataOffset);
+        const auto *pickingIndices = reinterpret_cast<const uint32_t *>(data + record.pickingIndicesOffset);
+        const auto *bvhNodes = reinterpret_cast<const BvhNode *>(data + record.bvhNodesOffset);
+
+        // picking was built over the dequantized positions, see prepareMesh
+        const PositionDequantization dequantization{
+            QVector3D(record.positionOffset[0], record.positionOffset[1], record.positionOffset[2]),
+            QVector3D(record.positionScale[0], record.positionScale[1], record.positionScale[2])
+        };
+        std::vector<QVector3D> positions;
+        positions.reserve(record.vertexCount);
+        for (quint32 v = 0; v < record.vertexCount; ++v) {
+            positions.push_back(dequantizePosition(vertexData[v], dequantization));
+        }
+
+        std::vector<uint32_t> orderedIndices(pickingIndices, pickingIndices + lodIndexCounts[0]);
+        if (std::any_of(orderedIndices.begin(), orderedIndices.end(),
+                        [&](const uint32_t index) { return index >= record.vertexCount; })) {
+            return false;
+        }
+        std::vector<BvhNode> nodes(bvhNodes, bvhNodes + record.bvhNodeCount);
+        // leaves reference triangles
+        if (!Bvh::validNodes(nodes, lodIndexCounts[0] / 3)) {
+            return false;
+        }
+
+        m_meshes.push_back({
+            record.materialIndex,
+            record.vertexCount,
+            vertexData,
+            dequantization,
+            record.indexCount,
+            record.indexSize == sizeof(quint32),
+            data + record.indexDataOffset,
+            lodIndexCounts,
+            QVector3D(record.centroid[0], record.centroid[1], record.centroid[2]),
+            std::make_shared<const PickingGeometry>(
+                std::move(positions),
+                std::move(orderedIndices),
+                std::move(nodes))
+        });
+    }
+
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <qvectornd.h>
+
+#include "Picking.h"
+#include "TextureCache.h"
+#include "VertexQuantization.h"
+
+struct aiMesh;
+struct aiScene;
+
+// position, normal, uv, as the meshes are prepared, uploaded quantized (see QuantizedVertex)
+constexpr int VERTEX_STRIDE = 3 + 3 + 2;
+
+// everything an Entity needs, ready to upload
+struct CachedMesh {
+    unsigned int materialIndex;
+    unsigned int numVertices;
+    const QuantizedVertex *vertexData;
+    PositionDequantization dequantization;
+    // every level of detail together
+    unsigned int numIndices;
+    // 16 bit when every vertex can be addressed with it, 32 bit otherwise
+    bool indices32Bit;
+    // the levels of detail one after the other, full detail first, all indexing the same vertices
+    const void *indexData;
+    std::vector<unsigned int> lodIndexCounts;
+    QVector3D centroid;
+    std::shared_ptr<const PickingGeometry> picking;
+};
+
+// quantized, indexed mesh and its picking hierarchy, owning the data, before it is written to a cache
+struct PreparedMesh {
+    unsigned int materialIndex;
+    std::vector<QuantizedVertex> vertexData;
+    PositionDequantization dequantization;
+    // every level of detail, see CachedMesh
+    std::vector<uint32_t> indices;
+    std::vector<unsigned int> lodIndexCounts;
+    QVector3D centroid;
+    std::shared_ptr<const PickingGeometry> picking;
+
+    CachedMesh view() const;
+};
+
+// Preprocessed form of an imported model: quantized vertex and index buffers, centroids, picking hierarchies and the
+// hashes of the material textures in one versioned binary file. Later starts map it and upload straight from the mapping,
+// skipping assimp. The textures themselves live in the TextureCache.
+// The file is only valid for the source file hash and import flags it was built with.
+class MeshCache {
+public:
+    // cache file for a model, in the per user cache directory, named after the file and a hash of its canonical path
+    static QString cachePathFor(const QString &sourcePath);
+    // empty when the source file cannot be read
+    static QByteArray hashSourceFile(const QString &sourcePath);
+    // serializes an imported scene, empty on error (unreadable texture)
+    static QByteArray build(const aiScene &scene, const QByteArray &sourceHash, unsigned int importFlags);
+
+    // The steps of build, for callers spreading them over threads. Meshes are independent of each other and of
+    // the textures, prepareMesh can run concurrently with TextureCache::encode.
+    static bool findTextures(const aiScene &scene, std::vector<TextureSource> &textures);
+    // number of full detail indices prepareMesh keeps, without preparing it
+    static unsigned int triangleIndexCount(const aiMesh &mesh);
+    // most indices prepareMesh may produce over all levels of detail
+    static unsigned int indexCapacity(const aiMesh &mesh);
+    static PreparedMesh prepareMesh(const aiMesh &mesh);
+    static QByteArray serialize(const QByteArray &sourceHash, unsigned int importFlags,
+                                const std::vector<TextureSource> &textures, const std::vector<PreparedMesh> &meshes);
+
+    // maps the cache file, false when it is missing, damaged, of another format version or stale
+    bool openFile(const QString &cachePath, const QByteArray &sourceHash, unsigned int importFlags);
+    // uses a freshly built cache kept in memory, for when it could not be written to disk
+    bool openBytes(QByteArray bytes, const QByteArray &sourceHash, unsigned int importFlags);
+
+    // without embedded images, see TextureCache
+    const std::vector<TextureSource> &textures() const {
+        return m_textures;
+    }
+
+    const std::vector<CachedMesh> &meshes() const {
+        return m_meshes;
+    }
+
+private:
+    bool parse(const uchar *data, qint64 size, const QByteArray &sourceHash, unsigned int importFlags);
+
+    // keeps the mapping (or m_bytes) alive, CachedMesh points into it
+    QFile m_file;
+    QByteArray m_bytes;
+    std::vector<TextureSource> m_textures;
+    std::vector<CachedMesh> m_meshes;
+};
+
+
+#endif //MESHCACHE_H
@@ -0,0 +1,249 @@
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <assimp/Importer.hpp>
+
+#include "DracoPackage.h"
+#include "MappedIOSystem.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "assimp/scene.h"
+
+namespace {
+void writeCacheFile(const QString &path, const QByteArray &bytes, const char *kind) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile cacheFile(path);
+    if (cacheFile.open(QIODevice::WriteOnly) && cacheFile.write(bytes) == bytes.size() && cacheFile.commit()) {
+        std::cout << "Wrote " << kind << ": " << path.toStdString() << std::endl;
+    } else {
+        std::cerr << "Error writing " << kind << ": " << path.toStdString() << std::endl;
+    }
+}
+}
+
+ModelLoader::ModelLoader(QString modelPath, const unsigned int importFlags, const bool meshCacheEnabled,
+                         const bool mappedImport, const TextureEncoding textureEncoding)
+    : m_modelPath(std::move(modelPath)), m_importFlags(importFlags), m_meshCacheEnabled(meshCacheEnabled),
+      m_mappedImport(mappedImport), m_textureEncoding(textureEncoding), m_thread(&ModelLoader::run, this) {
+}
+
+ModelLoader::~ModelLoader() {
+    // an import in progress cannot be interrupted, the remaining meshes are skipped
+    m_stopping = true;
+    m_thread.join();
+}
+
+LoadProgress ModelLoader::takeProgress() {
+    std::lock_guard lock(m_progressMutex);
+    return std::exchange(m_progress, {});
+}
+
+void ModelLoader::waitForProgress(const std::chrono::milliseconds timeout) {
+    std::unique_lock lock(m_progressMutex);
+    m_progressReady.wait_for(lock, timeout, [this] {
+        return m_progress.layout.has_value() || !m_progress.textures.empty() || !m_progress.meshes.empty() ||
+               m_progress.finished || m_progress.failed;
+    });
+}
+
+void ModelLoader::fail(const QString &message) {
+    m_stopping = true;
+    publish([&message](LoadProgress &progress) {
+        // jobs failing at the same time, the first one is reported
+        if (!progress.failed) {
+            progress.failed = true;
+            progress.error = message;
+        }
+    });
+}
+
+template<typename Change>
+void ModelLoader::publish(Change change) {
+    {
+        std::lock_guard lock(m_progressMutex);
+        change(m_progress);
+    }
+    m_progressReady.notify_all();
+}
+
+void ModelLoader::run() {
+    Profiler::instance().setThreadName("model loader");
+    const auto sourceHash = MeshCache::hashSourceFile(m_modelPath);
+    if (sourceHash.isEmpty()) {
+        fail(QLatin1String("Error reading model: ") + m_modelPath);
+        return;
+    }
+
+    const auto cachePath = MeshCache::cachePathFor(m_modelPath);
+    if (m_meshCacheEnabled && loadFromCache(cachePath, sourceHash)) {
+        return;
+    }
+    import(cachePath, sourceHash);
+}
+
+bool ModelLoader::openTextureCache(const size_t index, const TextureSource &source, const QSize layerSize) {
+    auto textureCache = std::make_unique<TextureCache>();
+    if (!textureCache->openFile(TextureCache::cachePathFor(source.hash, layerSize, m_textureEncoding), source.hash,
+                                source.materialIndex, layerSize, m_textureEncoding)) {
+        return false;
+    }
+    m_textureCaches[index] = std::move(textureCache);
+    return true;
+}
+
+// everything is ready as soon as the files are mapped, handed over in one go
+bool ModelLoader::loadFromCache(const QString &cachePath, const QByteArray &sourceHash) {
+    if (!m_meshCache.openFile(cachePath, sourceHash, m_importFlags)) {
+        return false;
+    }
+
+    // the embedded images are only reachable through assimp, without their cached form the model is imported again
+    const auto &textures = m_meshCache.textures();
+    const auto layerSize = TextureCache::layerSize(textures, m_textureEncoding);
+    m_textureCaches.resize(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i) {
+        if (!openTextureCache(i, textures[i], layerSize)) {
+            return false;
+        }
+    }
+    std::cout << "Loaded mesh cache: " << cachePath.toStdString() << std::endl;
+
+    publish([this, layerSize](LoadProgress &progress) {
+        ModelLayout layout;
+        for (size_t i = 0; i < m_textureCaches.size(); ++i) {
+            const auto &texture = m_textureCaches[i]->texture();
+            layout.textures.push_back({texture.materialIndex, layerSize.width(), layerSize.height()});
+            progress.textures.emplace_back(i, texture);
+        }
+        for (size_t i = 0; i < m_meshCache.meshes().size(); ++i) {
+            const auto &mesh = m_meshCache.meshes()[i];
+            layout.meshes.push_back({mesh.materialIndex, mesh.numVertices, mesh.numIndices});
+            progress.meshes.emplace_back(i, mesh);
+        }
+        progress.layout = std::move(layout);
+        progress.finished = true;
+    });
+    return true;
+}
+
+void ModelLoader::import(const QString &cachePath, const QByteArray &sourceHash) {
+    Assimp::Importer importer;
+    setModelImportProperties(importer);
+    if (m_mappedImport) {
+        // owned by the importer
+        importer.SetIOHandler(new MappedIOSystem);
+    }
+    DracoPackage dracoPackage;
+    const aiScene *scene;
+    if (DracoPackage::isDracoFile(m_modelPath)) {
+        // already indexed and in edgebreaker traversal order, the import flags do not apply
+        const ProfileScope scope("decodeDraco");
+        if (!dracoPackage.open(m_modelPath)) {
+            fail(QLatin1String("Error decoding model: ") + m_modelPath);
+            return;
+        }
+        scene = dracoPackage.scene();
+        std::cout << "Decoded " << scene->mNumMeshes << " Draco meshes in " << dracoPackage.decodeMillis() << " ms"
+                  << std::endl;
+    } else {
+        const ProfileScope scope("import");
+        scene = importer.ReadFile(m_modelPath.toStdString(), m_importFlags);
+        if (!scene) {
+            fail(QLatin1String("Error importing model: ") + QString::fromUtf8(importer.GetErrorString()));
+            return;
+        }
+    }
+
+    std::vector<TextureSource> textureSources;
+    if (!MeshCache::findTextures(*scene, textureSources)) {
+        fail(QLatin1String("Error preparing model: ") + m_modelPath);
+        return;
+    }
+
+    const auto layerSize = TextureCache::layerSize(textureSources, m_textureEncoding);
+    ModelLayout layout;
+    for (const auto &source: textureSources) {
+        layout.textures.push_back({source.materialIndex, layerSize.width(), layerSize.height()});
+    }
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+        const auto &mesh = *scene->mMeshes[i];
+        // room for every level of detail, ranges are laid out before the levels are generated
+        layout.meshes.push_back({mesh.mMaterialIndex, mesh.mNumVertices, MeshCache::indexCapacity(mesh)});
+    }
+
+    // sized once, workers fill in their own elements and the handed over views point into them
+    m_textureCaches.clear();
+    m_textureCaches.resize(textureSources.size());
+    m_encodedTextures.resize(textureSources.size());
+    m_preparedMeshes.resize(scene->mNumMeshes);
+
+    // textures go first, then the biggest meshes, so that no thread is left with a long job at the very end
+    std::vector<unsigned int> meshOrder(scene->mNumMeshes);
+    std::iota(meshOrder.begin(), meshOrder.end(), 0u);
+    std::sort(meshOrder.begin(), meshOrder.end(), [&](const unsigned int a, const unsigned int b) {
+        return layout.meshes[a].indexCount > layout.meshes[b].indexCount;
+    });
+
+    publish([&layout](LoadProgress &progress) {
+        progress.layout = std::move(layout);
+    });
+
+    parallelFor(textureSources.size() + meshOrder.size(), [&](const size_t job) {
+        if (m_stopping) {
+            return;
+        }
+
+        if (job < textureSources.size()) {
+            const auto &source = textureSources[job];
+            if (m_meshCacheEnabled && openTextureCache(job, source, layerSize)) {
+                publish([&](LoadProgress &progress) {
+                    progress.textures.emplace_back(job, m_textureCaches[job]->texture());
+                });
+                return;
+            }
+            const ProfileScope scope("encodeTexture");
+            if (!TextureCache::encode(source, layerSize, m_textureEncoding, m_encodedTextures[job])) {
+                fail(QStringLiteral("Error loading texture of material %1").arg(source.materialIndex));
+                return;
+            }
+            publish([&](LoadProgress &progress) {
+                progress.textures.emplace_back(job, m_encodedTextures[job].view());
+            });
+            return;
+        }
+
+        const auto meshIndex = meshOrder[job - textureSources.size()];
+        const ProfileScope scope("prepareMesh");
+        m_preparedMeshes[meshIndex] = MeshCache::prepareMesh(*scene->mMeshes[meshIndex]);
+        publish([&](LoadProgress &progress) {
+            progress.meshes.emplace_back(meshIndex, m_preparedMeshes[meshIndex].view());
+        });
+    });
+
+    if (m_stopping) {
+        return;
+    }
+    publish([](LoadProgress &progress) {
+        progress.finished = true;
+    });
+
+    if (!m_meshCacheEnabled) {
+        return;
+    }
+
+    const ProfileScope scope("writeCache");
+    for (size_t i = 0; i < textureSources.size(); ++i) {
+        if (!m_textureCaches[i]) {
+            const auto &source = textureSources[i];
+            writeCacheFile(TextureCache::cachePathFor(source.hash, layerSize, m_textureEncoding),
+                           TextureCache::serialize(source.hash, m_encodedTextures[i]), "texture cache");
+        }
+    }
+    writeCacheFile(cachePath, MeshCache::serialize(sourceHash, m_importFlags, textureSources, m_preparedMeshes),
+                   "mesh cache");
+}
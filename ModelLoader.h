@@ -0,0 +1,119 @@
+#ifndef MODELLOADER_H
+#define MODELLOADER_H
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <QString>
+
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include "assimp/postprocess.h"
+#include <assimp/Importer.hpp>
+#include <assimp/config.h>
+
+// Indexed geometry: shared vertices welded and triangles reordered for the post-transform vertex cache.
+// inner_ear_vis_convert imports with the same flags
+constexpr unsigned int MODEL_IMPORT_FLAGS =
+        aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality;
+
+// importer properties going with MODEL_IMPORT_FLAGS: zlib-compressed arrays of binary FBX inflated and the meshes
+// post-processed on all cores
+inline void setModelImportProperties(Assimp::Importer &importer) {
+    importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PARALLEL_INFLATE, true);
+    importer.SetPropertyInteger(AI_CONFIG_PP_THREAD_COUNT, 0);
+}
+
+// sizes of everything a ModelLoader delivers, known before any of it is ready
+struct ModelLayout {
+    struct Mesh {
+        unsigned int materialIndex;
+        quint32 vertexCount;
+        // room for the indices of every level of detail, may end up partly unused
+        quint32 indexCount;
+    };
+
+    struct Texture {
+        unsigned int materialIndex;
+        int width;
+        int height;
+    };
+
+    std::vector<Mesh> meshes;
+    std::vector<Texture> textures;
+};
+
+// what finished since the last ModelLoader::takeProgress
+struct LoadProgress {
+    // set once, before any texture or mesh
+    std::optional<ModelLayout> layout;
+    // indices into ModelLayout::textures and ModelLayout::meshes, the data stays valid as long as the loader does
+    std::vector<std::pair<size_t, CachedTexture>> textures;
+    std::vector<std::pair<size_t, CachedMesh>> meshes;
+    bool finished = false;
+    // nothing else follows, the GUI thread reports error and quits
+    bool failed = false;
+    QString error;
+};
+
+// Loads a model off the GUI thread. An up to date mesh cache is mapped and handed over at once, otherwise the model
+// is imported with assimp (or decoded from Draco, see DracoPackage) and its textures and meshes are encoded and prepared on a pool of threads, each handed over
+// as soon as it is done, so the window can show parts while the rest is still loading. The caches are written last.
+// Textures found in the texture cache are mapped instead of being decoded, with or without a mesh cache.
+// Errors are fatal, but handed over in LoadProgress: exiting from the loader threads would tear the application down
+// while the GUI thread still renders.
+class ModelLoader {
+public:
+    // starts loading right away, textures are delivered in textureEncoding. mappedImport has assimp read the model
+    // through a memory mapping instead of copying it to the heap, see MappedIOSystem
+    ModelLoader(QString modelPath, unsigned int importFlags, bool meshCacheEnabled, bool mappedImport,
+                TextureEncoding textureEncoding);
+    ~ModelLoader();
+
+    ModelLoader(const ModelLoader &) = delete;
+    ModelLoader &operator=(const ModelLoader &) = delete;
+
+    LoadProgress takeProgress();
+    // blocks until there is progress to take or the timeout passes
+    void waitForProgress(std::chrono::milliseconds timeout);
+
+private:
+    void run();
+    bool loadFromCache(const QString &cachePath, const QByteArray &sourceHash);
+    // maps the cached form of a texture, m_textureCaches[index] keeps it
+    bool openTextureCache(size_t index, const TextureSource &source, QSize layerSize);
+    void import(const QString &cachePath, const QByteArray &sourceHash);
+    // skips the remaining jobs and hands message over
+    void fail(const QString &message);
+
+    template<typename Change>
+    void publish(Change change);
+
+    const QString m_modelPath;
+    const unsigned int m_importFlags;
+    const bool m_meshCacheEnabled;
+    const bool m_mappedImport;
+    const TextureEncoding m_textureEncoding;
+    std::atomic<bool> m_stopping{false};
+
+    // what the handed over views point into
+    MeshCache m_meshCache;
+    std::vector<std::unique_ptr<TextureCache>> m_textureCaches;
+    // only for textures missing from the texture cache
+    std::vector<EncodedTexture> m_encodedTextures;
+    std::vector<PreparedMesh> m_preparedMeshes;
+
+    std::mutex m_progressMutex;
+    std::condition_variable m_progressReady;
+    LoadProgress m_progress;
+
+    std::thread m_thread;
+};
+
+
+#endif //MODELLOADER_H
@@ -0,0 +1,32 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+// runs work(i) for every i in [0, count) on up to one thread per core, the calling thread included
+template<typename Work>
+void parallelFor(const size_t count, Work work) {
+    std::atomic<size_t> next{0};
+    const auto worker = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            work(i);
+        }
+    };
+
+    const size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), count);
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+
+#endif //PARALLELFOR_H
@@ -0,0 +1,135 @@
+#include "Picking.h"
+
+#include <cassert>
+
+#include "util.h"
+
+PickingGeometry::PickingGeometry(std::vector<QVector3D> positions, std::vector<uint32_t> indices)
+    : m_positions(std::move(positions)) {
+    assert(indices.size() % 3 == 0);
+    const size_t triangleCount = indices.size() / 3;
+
+    std::vector<Aabb> triangleBounds(triangleCount);
+    for (size_t i = 0; i < triangleCount; ++i) {
+        triangleBounds[i].grow(m_positions[indices[3 * i]]);
+        triangleBounds[i].grow(m_positions[indices[3 * i + 1]]);
+        triangleBounds[i].grow(m_positions[indices[3 * i + 2]]);
+    }
+    m_bvh.build(triangleBounds);
+
+    // store triangles in leaf order, traversal then walks contiguous memory
+    m_indices.reserve(indices.size());
+    for (const auto triangle: m_bvh.primitiveOrder()) {
+        m_indices.push_back(indices[3 * triangle]);
+        m_indices.push_back(indices[3 * triangle + 1]);
+        m_indices.push_back(indices[3 * triangle + 2]);
+    }
+    m_triangles.build(m_positions, m_indices);
+}
+
+size_t PickingGeometry::memoryBytes() const {
+    return m_positions.capacity() * sizeof(QVector3D) + m_indices.capacity() * sizeof(uint32_t) +
+           m_triangles.memoryBytes() + m_bvh.nodes().capacity() * sizeof(BvhNode);
+}
+
+PickingGeometry::PickingGeometry(std::vector<QVector3D> positions, std::vector<uint32_t> orderedIndices,
+                                 std::vector<BvhNode> bvhNodes)
+    : m_positions(std::move(positions)), m_indices(std::move(orderedIndices)),
+      m_bvh(Bvh::fromNodes(std::move(bvhNodes))) {
+    m_triangles.build(m_positions, m_indices);
+}
+
+std::optional<float> PickingGeometry::intersect(const QVector3D rayOrigin, const QVector3D rayDir,
+                                                const float maxDistance) const {
+    float closestDistance = maxDistance;
+    bool hit = false;
+
+    m_bvh.traverse(rayOrigin, rayDir, closestDistance, [&](const uint32_t first, const uint32_t count, float &closest) {
+        hit |= m_triangles.intersect(rayOrigin, rayDir, first, count, closest);
+    });
+
+    if (hit) {
+        return closestDistance;
+    }
+    return std::nullopt;
+}
+
+PickingScene::PickingScene(std::vector<std::shared_ptr<const PickingGeometry>> entities)
+    : m_entities(std::move(entities)) {
+    std::vector<Aabb> entityBounds;
+    entityBounds.reserve(m_entities.size());
+    for (const auto &entity: m_entities) {
+        entityBounds.push_back(entity->bounds());
+    }
+    m_bvh.build(entityBounds);
+}
+
+PickResult PickingScene::pick(const QVector3D rayOrigin, const QVector3D rayDir) const {
+    PickResult result;
+    pickClosest(rayOrigin, rayDir, result);
+    return result;
+}
+
+PickResult PickingScene::pick(const QVector3D rayOrigin, const QVector3D rayDir,
+                              const std::vector<QVector3D> &instanceOffsets) const {
+    PickResult result;
+    // the direction is shared, so distances compare across instances and later ones skip what is behind the hit
+    for (int instanceIndex = 0; instanceIndex < instanceOffsets.size(); ++instanceIndex) {
+        if (pickClosest(rayOrigin - instanceOffsets[instanceIndex], rayDir, result)) {
+            result.instanceIndex = instanceIndex;
+        }
+    }
+    return result;
+}
+
+bool PickingScene::pickClosest(const QVector3D rayOrigin, const QVector3D rayDir, PickResult &result) const {
+    const auto &entityOrder = m_bvh.primitiveOrder();
+    bool hit = false;
+
+    // entities come front to back by their bounds, ones behind the closest hit so far are never descended into
+    m_bvh.traverse(rayOrigin, rayDir, result.distance, [&](const uint32_t first, const uint32_t count,
+                                                           float &closest) {
+        for (uint32_t position = first; position < first + count; ++position) {
+            const auto entityIndex = static_cast<int>(entityOrder[position]);
+            const auto entityHit = m_entities[entityIndex]->intersect(rayOrigin, rayDir, closest);
+            if (entityHit.has_value()) {
+                closest = entityHit.value();
+                result.entityIndex = entityIndex;
+                hit = true;
+            }
+        }
+    });
+
+    return hit;
+}
+
+PickResult PickingScene::pickLinear(const QVector3D rayOrigin, const QVector3D rayDir) const {
+    PickResult result;
+    for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
+        const auto &positions = m_entities[entityIndex]->positions();
+        const auto &indices = m_entities[entityIndex]->indices();
+        for (size_t i = 0; i < indices.size() / 3; ++i) {
+            const auto v0 = positions[indices[3 * i]];
+            const auto v1 = positions[indices[3 * i + 1]];
+            const auto v2 = positions[indices[3 * i + 2]];
+
+            const auto hit = doesRayIntersectTriangle(rayOrigin, rayDir, v0, v1, v2);
+            if (hit.has_value() && hit.value() < result.distance) {
+                result.distance = hit.value();
+                result.entityIndex = entityIndex;
+            }
+        }
+    }
+    return result;
+}
+
+PickResult PickingScene::pickLinearVectorized(const QVector3D rayOrigin, const QVector3D rayDir) const {
+    PickResult result;
+    for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
+        const auto &triangles = m_entities[entityIndex]->triangles();
+        if (triangles.intersect(rayOrigin, rayDir, 0, triangles.size(), result.distance)) {
+            result.entityIndex = entityIndex;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef PICKING_H
+#define PICKING_H
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <qvectornd.h>
+
+#include "Bvh.h"
+#include "TriangleSoa.h"
+
+
+struct PickResult {
+    int entityIndex = -1;
+    // specimen of the comparison view, see PickingScene::pick with instance offsets
+    int instanceIndex = 0;
+    float distance = std::numeric_limits<float>::max();
+};
+
+// Picking triangles of a single entity. Never modified once built, so it can be shared with the picking thread.
+class PickingGeometry {
+public:
+    // indices hold three entries per triangle
+    PickingGeometry(std::vector<QVector3D> positions, std::vector<uint32_t> indices);
+    // indices already in leaf order of bvhNodes, as stored in the mesh cache
+    PickingGeometry(std::vector<QVector3D> positions, std::vector<uint32_t> orderedIndices,
+                    std::vector<BvhNode> bvhNodes);
+
+    // distance along the ray to the closest triangle hit
+    std::optional<float> intersect(QVector3D rayOrigin, QVector3D rayDir, float maxDistance) const;
+
+    const std::vector<QVector3D> &positions() const {
+        return m_positions;
+    }
+
+    // triangles are reordered so that the bvh leaves index them directly
+    const std::vector<uint32_t> &indices() const {
+        return m_indices;
+    }
+
+    // the same triangles, in the same order, laid out for the vectorized intersection kernels
+    const TriangleSoa &triangles() const {
+        return m_triangles;
+    }
+
+    Aabb bounds() const {
+        return m_bvh.bounds();
+    }
+
+    const std::vector<BvhNode> &bvhNodes() const {
+        return m_bvh.nodes();
+    }
+
+    // heap memory of the positions, indices, triangle streams and hierarchy
+    size_t memoryBytes() const;
+
+private:
+    std::vector<QVector3D> m_positions;
+    std::vector<uint32_t> m_indices;
+    TriangleSoa m_triangles;
+    Bvh m_bvh;
+};
+
+// Immutable snapshot of all entities with a top level hierarchy over their bounds.
+// Entity indices in PickResult are positions in the vector given to the constructor.
+class PickingScene {
+public:
+    explicit PickingScene(std::vector<std::shared_ptr<const PickingGeometry>> entities);
+
+    PickResult pick(QVector3D rayOrigin, QVector3D rayDir) const;
+    // Every entity placed again at each offset, instances being rigid copies of the scene: the ray is moved by the
+    // offset instead of the geometry, so offsets are in the space of the ray. Empty offsets pick nothing.
+    PickResult pick(QVector3D rayOrigin, QVector3D rayDir, const std::vector<QVector3D> &instanceOffsets) const;
+    // reference brute force over every triangle, kept for benchmarking
+    PickResult pickLinear(QVector3D rayOrigin, QVector3D rayDir) const;
+    // brute force through the vectorized kernel, isolates its gain from the hierarchy's
+    PickResult pickLinearVectorized(QVector3D rayOrigin, QVector3D rayDir) const;
+
+private:
+    // closer hits than result.distance replace its entity, true when there was one
+    bool pickClosest(QVector3D rayOrigin, QVector3D rayDir, PickResult &result) const;
+
+    std::vector<std::shared_ptr<const PickingGeometry>> m_entities;
+    Bvh m_bvh;
+};
+
+
+#endif //PICKING_H
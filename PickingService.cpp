@@ -0,0 +1,92 @@
+#include "PickingService.h"
+
+#include <cassert>
+
+#include "Profiler.h"
+
+namespace {
+// the lower half of the published result, entity indices stay below 2^24
+constexpr uint32_t INSTANCE_SHIFT = 24;
+constexpr uint64_t ENTITY_MASK = (1u << INSTANCE_SHIFT) - 1;
+}
+
+PickingService::PickingService(std::shared_ptr<const PickingScene> scene)
+    : m_scene(std::move(scene)), m_thread(&PickingService::run, this) {
+}
+
+PickingService::~PickingService() {
+    {
+        std::lock_guard lock(m_requestMutex);
+        m_stopping = true;
+    }
+    m_requestReady.notify_one();
+    m_thread.join();
+}
+
+uint32_t PickingService::submit(const QVector3D rayOrigin, const QVector3D rayDir,
+                                std::vector<QVector3D> instanceOffsets) {
+    assert(instanceOffsets.size() <= MAX_INSTANCES);
+    const uint32_t sequence = m_nextSequence++;
+    m_latestSequence.store(sequence, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(m_requestMutex);
+        if (m_pendingRequest.has_value()) {
+            m_coalescedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_pendingRequest = Request{rayOrigin, rayDir, std::move(instanceOffsets), sequence};
+    }
+    m_requestReady.notify_one();
+    return sequence;
+}
+
+void PickingService::setScene(std::shared_ptr<const PickingScene> scene) {
+    std::lock_guard lock(m_requestMutex);
+    m_scene = std::move(scene);
+}
+
+std::optional<HoverPick> PickingService::latestResult() const {
+    const uint64_t packed = m_result.load(std::memory_order_acquire);
+    if (packed == 0) {
+        return std::nullopt;
+    }
+    return HoverPick{
+        static_cast<uint32_t>(packed >> 32),
+        static_cast<int>(packed & ENTITY_MASK) - 1,
+        static_cast<int>(static_cast<uint32_t>(packed) >> INSTANCE_SHIFT)
+    };
+}
+
+void PickingService::run() {
+    Profiler::instance().setThreadName("picking");
+    while (true) {
+        Request request;
+        std::shared_ptr<const PickingScene> scene;
+        {
+            std::unique_lock lock(m_requestMutex);
+            m_requestReady.wait(lock, [this] { return m_stopping || m_pendingRequest.has_value(); });
+            if (m_stopping) {
+                return;
+            }
+            request = std::move(m_pendingRequest.value());
+            m_pendingRequest.reset();
+            scene = m_scene;
+        }
+
+        PickResult result;
+        {
+            const ProfileScope scope("pick");
+            result = scene->pick(request.rayOrigin, request.rayDir, request.instanceOffsets);
+        }
+
+        // the mouse moved on while picking, the newer request is already queued
+        if (m_latestSequence.load(std::memory_order_relaxed) != request.sequence) {
+            m_coalescedCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const uint64_t packed = static_cast<uint64_t>(request.sequence) << 32 |
+                                static_cast<uint32_t>(result.instanceIndex) << INSTANCE_SHIFT |
+                                static_cast<uint32_t>(result.entityIndex + 1);
+        m_result.store(packed, std::memory_order_release);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PICKINGSERVICE_H
+#define PICKINGSERVICE_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <qvectornd.h>
+
+#include "Picking.h"
+
+
+struct HoverPick {
+    // sequence number returned by PickingService::submit for the ray that produced this result
+    uint32_t sequence = 0;
+    int entityIndex = -1;
+    int instanceIndex = 0;
+};
+
+// Picks on a background thread against an immutable PickingScene.
+// Only the latest ray matters: a request still waiting when a newer one comes in is dropped (coalesced),
+// and a result whose request got superseded while it was being evaluated is never published.
+class PickingService {
+public:
+    explicit PickingService(std::shared_ptr<const PickingScene> scene);
+    ~PickingService();
+
+    PickingService(const PickingService &) = delete;
+    PickingService &operator=(const PickingService &) = delete;
+
+    // called from the GUI thread only, returns the sequence number of the request.
+    // Picks every instance of the scene, see PickingScene::pick, at most MAX_INSTANCES of them
+    uint32_t submit(QVector3D rayOrigin, QVector3D rayDir, std::vector<QVector3D> instanceOffsets);
+
+    static constexpr int MAX_INSTANCES = 256;
+
+    // picks against scene from the next request on, for geometry that grows while the model loads
+    void setScene(std::shared_ptr<const PickingScene> scene);
+
+    // most recent published result, lock free, safe to poll every frame
+    std::optional<HoverPick> latestResult() const;
+
+    uint32_t coalescedCount() const {
+        return m_coalescedCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Request {
+        QVector3D rayOrigin;
+        QVector3D rayDir;
+        std::vector<QVector3D> instanceOffsets;
+        uint32_t sequence;
+    };
+
+    void run();
+
+    std::mutex m_requestMutex;
+    std::shared_ptr<const PickingScene> m_scene;
+    std::condition_variable m_requestReady;
+    std::optional<Request> m_pendingRequest;
+    bool m_stopping = false;
+    uint32_t m_nextSequence = 1;
+
+    std::atomic<uint32_t> m_latestSequence{0};
+    std::atomic<uint32_t> m_coalescedCount{0};
+    // sequence in the upper half, instance index in the top byte of the lower and entity index + 1 below it,
+    // 0 until the first result
+    std::atomic<uint64_t> m_result{0};
+
+    std::thread m_thread;
+};
+
+
+#endif //PICKINGSERVICE_H
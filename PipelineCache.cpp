@@ -0,0 +1,70 @@
+#include "PipelineCache.h"
+
+#include <iostream>
+#include <tuple>
+
+bool PipelineKey::operator<(const PipelineKey &other) const {
+    return std::tie(program, blend, topology, depth, pass, colorAttachments) <
+           std::tie(other.program, other.blend, other.topology, other.depth, other.pass, other.colorAttachments);
+}
+
+PipelineCache::PipelineCache(QRhi &rhi, QRhiRenderPassDescriptor *renderPass)
+    : m_rhi(rhi) {
+    registerRenderPass(RenderPass::Main, renderPass, 1);
+}
+
+void PipelineCache::registerProgram(const ShaderProgram program, ProgramDescription description) {
+    m_programs[program] = std::move(description);
+}
+
+void PipelineCache::registerRenderPass(const RenderPass pass, QRhiRenderPassDescriptor *descriptor,
+                                       const int colorAttachments) {
+    m_renderPasses[pass] = {descriptor, colorAttachments};
+}
+
+QRhiGraphicsPipeline *PipelineCache::pipeline(const PipelineKey &key) {
+    const auto cached = m_pipelines.find(key);
+    if (cached != m_pipelines.end()) {
+        return cached->second.get();
+    }
+
+    const auto program = m_programs.find(key.program);
+    if (program == m_programs.end()) {
+        std::cerr << "Pipeline requested for unregistered program " << static_cast<int>(key.program) << std::endl;
+        return nullptr;
+    }
+    const auto renderPass = m_renderPasses.find(key.pass);
+    if (renderPass == m_renderPasses.end()) {
+        std::cerr << "Pipeline requested for unregistered render pass " << static_cast<int>(key.pass) << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<QRhiGraphicsPipeline> pipeline(m_rhi.newGraphicsPipeline());
+    pipeline->setDepthTest(key.depth != DepthMode::Disabled);
+    pipeline->setDepthWrite(key.depth == DepthMode::TestAndWrite);
+    // the defaults blend premultiplied alpha
+    QRhiGraphicsPipeline::TargetBlend targetBlend;
+    targetBlend.enable = key.blend == BlendMode::PremultipliedAlpha || key.blend == BlendMode::Additive;
+    if (key.blend == BlendMode::Additive) {
+        targetBlend.dstColor = QRhiGraphicsPipeline::One;
+        targetBlend.dstAlpha = QRhiGraphicsPipeline::One;
+    }
+    QList<QRhiGraphicsPipeline::TargetBlend> targetBlends(renderPass->second.colorAttachments, targetBlend);
+    for (int attachment = 0; attachment < targetBlends.size(); ++attachment) {
+        if ((key.colorAttachments & (1u << attachment)) == 0) {
+            targetBlends[attachment].colorWrite = {};
+        }
+    }
+    pipeline->setTargetBlends(targetBlends.cbegin(), targetBlends.cend());
+    pipeline->setTopology(key.topology);
+    pipeline->setShaderStages(program->second.shaderStages.begin(), program->second.shaderStages.end());
+    pipeline->setVertexInputLayout(program->second.inputLayout);
+    pipeline->setShaderResourceBindings(program->second.layout);
+    pipeline->setRenderPassDescriptor(renderPass->second.descriptor);
+    if (!pipeline->create()) {
+        std::cerr << "Error creating graphics pipeline" << std::endl;
+        return nullptr;
+    }
+    ++m_pipelineCreations;
+    return m_pipelines.emplace(key, std::move(pipeline)).first->second.get();
+}
@@ -0,0 +1,98 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+#include <map>
+#include <memory>
+#include <rhi/qrhi.h>
+
+
+enum class ShaderProgram : int {
+    Color,
+    Ray,
+    // screen space stats overlay, see AppWindow::updateStatsOverlay
+    Overlay,
+    // the color program writing into the translucency targets, see AppWindow::updateTranslucencyTargets
+    ColorTranslucent,
+    // full screen triangle resolving the translucency targets over the frame
+    TranslucencyComposite
+};
+
+enum class BlendMode : int {
+    Opaque,
+    PremultipliedAlpha,
+    // one plus one, the sums of weighted blended order-independent transparency
+    Additive
+};
+
+enum class DepthMode : int {
+    TestAndWrite,
+    // drawn over everything, whatever the depth buffer holds
+    Disabled,
+    // hidden behind what is there already, without hiding anything itself
+    TestOnly
+};
+
+// the render passes pipelines are built for, each with its own color attachments
+enum class RenderPass : int {
+    // the swapchain (or the offscreen texture), one color attachment
+    Main,
+    // while parts are translucent: the opaque parts, then accumulated color and transmittance of the others
+    Translucency
+};
+
+// render state a pipeline is built for, everything else about it comes from the registered program
+struct PipelineKey {
+    ShaderProgram program;
+    BlendMode blend;
+    QRhiGraphicsPipeline::Topology topology;
+    DepthMode depth = DepthMode::TestAndWrite;
+    RenderPass pass = RenderPass::Main;
+    // bit i for every color attachment of the pass the program writes, the others are masked off
+    quint32 colorAttachments = ~0u;
+
+    bool operator<(const PipelineKey &other) const;
+};
+
+// shaders and vertex layout shared by every pipeline of a program
+struct ProgramDescription {
+    QList<QRhiShaderStage> shaderStages;
+    QRhiVertexInputLayout inputLayout;
+    // any bindings of the program, pipelines only depend on their layout
+    QRhiShaderResourceBindings *layout = nullptr;
+};
+
+// Owns every pipeline the app draws with. Pipelines are built on first request and reused afterwards,
+// so a frame only switches between existing ones with setGraphicsPipeline.
+// Creations are counted, after customInit the count is expected to stay put.
+class PipelineCache {
+public:
+    // renderPass is the descriptor of RenderPass::Main
+    PipelineCache(QRhi &rhi, QRhiRenderPassDescriptor *renderPass);
+
+    void registerProgram(ShaderProgram program, ProgramDescription description);
+    // colorAttachments is how many the pass renders into, each written one gets the blend of the pipeline key
+    void registerRenderPass(RenderPass pass, QRhiRenderPassDescriptor *descriptor, int colorAttachments);
+
+    // nullptr when the program or the render pass isn't registered or the backend can't create the pipeline,
+    // asking again tries again
+    QRhiGraphicsPipeline *pipeline(const PipelineKey &key);
+
+    quint64 pipelineCreations() const {
+        return m_pipelineCreations;
+    }
+
+private:
+    struct RenderPassDescription {
+        QRhiRenderPassDescriptor *descriptor;
+        int colorAttachments;
+    };
+
+    QRhi &m_rhi;
+    std::map<RenderPass, RenderPassDescription> m_renderPasses;
+    std::map<ShaderProgram, ProgramDescription> m_programs;
+
+    std::map<PipelineKey, std::unique_ptr<QRhiGraphicsPipeline>> m_pipelines;
+    quint64 m_pipelineCreations = 0;
+};
+
+
+#endif //PIPELINECACHE_H
@@ -0,0 +1,114 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+// thread ids start at 1, the GPU gets a track of its own
+constexpr uint32_t GPU_TRACK = 0;
+}
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() {
+    m_clock.start();
+    m_events.reserve(CAPACITY);
+    m_threadNames[GPU_TRACK] = "GPU";
+}
+
+uint32_t Profiler::currentThreadId() {
+    static std::atomic<uint32_t> nextId{GPU_TRACK + 1};
+    thread_local const uint32_t id = nextId++;
+    return id;
+}
+
+void Profiler::setThreadName(const char *name) {
+    std::lock_guard lock(m_mutex);
+    m_threadNames[currentThreadId()] = name;
+}
+
+void Profiler::add(const ProfileEvent &event) {
+    std::lock_guard lock(m_mutex);
+    if (m_events.size() < CAPACITY) {
+        m_events.push_back(event);
+    } else {
+        m_events[m_next] = event;
+    }
+    m_next = (m_next + 1) % CAPACITY;
+}
+
+void Profiler::addScope(const char *name, const qint64 startNanos, const qint64 durationNanos) {
+    add({ProfileEvent::Kind::Scope, name, currentThreadId(), startNanos, durationNanos, 0.0});
+}
+
+void Profiler::addGpuFrame(const qint64 submitNanos, const double gpuSeconds) {
+    const auto durationNanos = static_cast<qint64>(gpuSeconds * 1e9);
+    add({ProfileEvent::Kind::GpuFrame, "gpu frame", GPU_TRACK, submitNanos, durationNanos, gpuSeconds * 1e3});
+}
+
+void Profiler::addCounter(const char *name, const double value) {
+    add({ProfileEvent::Kind::Counter, name, currentThreadId(), nowNanos(), 0, value});
+}
+
+std::vector<ProfileEvent> Profiler::eventsSince(const qint64 sinceNanos) const {
+    std::lock_guard lock(m_mutex);
+    std::vector<ProfileEvent> events;
+    // walking back from the newest, scopes are added when they end so the order is by end time
+    for (size_t i = 0; i < m_events.size(); ++i) {
+        const auto &event = m_events[(m_next + m_events.size() - 1 - i) % m_events.size()];
+        if (event.startNanos + event.durationNanos < sinceNanos) {
+            break;
+        }
+        events.push_back(event);
+    }
+    std::reverse(events.begin(), events.end());
+    return events;
+}
+
+bool Profiler::writeChromeTrace(const QString &path) const {
+    QJsonArray traceEvents;
+    {
+        std::lock_guard lock(m_mutex);
+        for (const auto &[threadId, name]: m_threadNames) {
+            traceEvents.append(QJsonObject{
+                {"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", static_cast<qint64>(threadId)},
+                {"args", QJsonObject{{"name", name}}},
+            });
+        }
+
+        // oldest first, once the ring is full that is the next one to be overwritten
+        const size_t oldest = m_events.size() < CAPACITY ? 0 : m_next;
+        for (size_t i = 0; i < m_events.size(); ++i) {
+            const auto &event = m_events[(oldest + i) % m_events.size()];
+            // trace_event times are in microseconds
+            QJsonObject json{
+                {"name", event.name},
+                {"pid", 1},
+                {"tid", static_cast<qint64>(event.threadId)},
+                {"ts", event.startNanos / 1e3},
+            };
+            if (event.kind == ProfileEvent::Kind::Counter) {
+                json["ph"] = "C";
+                json["args"] = QJsonObject{{event.name, event.value}};
+            } else {
+                json["ph"] = "X";
+                json["dur"] = event.durationNanos / 1e3;
+            }
+            traceEvents.append(json);
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const QJsonObject trace{{"traceEvents", traceEvents}, {"displayTimeUnit", "ms"}};
+    return file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) > 0;
+}
@@ -0,0 +1,91 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <QElapsedTimer>
+#include <QString>
+
+
+// a finished CPU scope, the GPU time of a frame or a counter sample, times in nanoseconds since the profiler started
+struct ProfileEvent {
+    enum class Kind : uint8_t {
+        Scope,
+        GpuFrame,
+        Counter
+    };
+
+    Kind kind;
+    // string literal, only the pointer is kept
+    const char *name;
+    uint32_t threadId;
+    qint64 startNanos;
+    qint64 durationNanos;
+    // counters only
+    double value;
+};
+
+// Process wide ring buffer of the most recent events, written from any thread. Always on: a scope costs two clock reads
+// and a short locked copy, so when a stutter is reported the frames around it are still there to be dumped.
+class Profiler {
+public:
+    static constexpr size_t CAPACITY = 1 << 16;
+
+    static Profiler &instance();
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    qint64 nowNanos() const {
+        return m_clock.nsecsElapsed();
+    }
+
+    // shown as the track name in the trace, name must be a string literal
+    void setThreadName(const char *name);
+
+    void addScope(const char *name, qint64 startNanos, qint64 durationNanos);
+    // The GPU clock is not synchronized with ours, the frame is placed where the CPU finished submitting it.
+    void addGpuFrame(qint64 submitNanos, double gpuSeconds);
+    void addCounter(const char *name, double value);
+
+    // events that ended after sinceNanos, oldest first
+    std::vector<ProfileEvent> eventsSince(qint64 sinceNanos) const;
+    // everything still in the ring as Chrome trace_event JSON (chrome://tracing, Perfetto)
+    bool writeChromeTrace(const QString &path) const;
+
+private:
+    Profiler();
+    void add(const ProfileEvent &event);
+    static uint32_t currentThreadId();
+
+    QElapsedTimer m_clock;
+    mutable std::mutex m_mutex;
+    std::vector<ProfileEvent> m_events;
+    // where the next event goes, the oldest one once the ring is full
+    size_t m_next = 0;
+    std::map<uint32_t, const char *> m_threadNames;
+};
+
+// records the enclosing block as a scope of the given name, a string literal
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name)
+        : m_name(name), m_startNanos(Profiler::instance().nowNanos()) {
+    }
+
+    ~ProfileScope() {
+        auto &profiler = Profiler::instance();
+        profiler.addScope(m_name, m_startNanos, profiler.nowNanos() - m_startNanos);
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const char *m_name;
+    qint64 m_startNanos;
+};
+
+
+#endif //PROFILER_H
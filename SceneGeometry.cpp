@@ -0,0 +1,74 @@
+#include "SceneGeometry.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+template<typename Index>
+QByteArray rebased(const CachedMesh &mesh, const quint32 firstVertex) {
+    std::vector<Index> indices(mesh.numIndices);
+    for (unsigned int i = 0; i < mesh.numIndices; ++i) {
+        const quint32 index = mesh.indices32Bit
+                                  ? static_cast<const quint32 *>(mesh.indexData)[i]
+                                  : static_cast<const quint16 *>(mesh.indexData)[i];
+        indices[i] = static_cast<Index>(firstVertex + index);
+    }
+    return QByteArray(reinterpret_cast<const char *>(indices.data()),
+                      static_cast<qsizetype>(indices.size() * sizeof(Index)));
+}
+}
+
+void SceneGeometry::allocate(QRhi &rhi, const ModelLayout &layout) {
+    m_ranges.clear();
+    m_ranges.reserve(layout.meshes.size());
+
+    quint32 vertexCount = 0;
+    quint32 indexCount = 0;
+    for (const auto &mesh: layout.meshes) {
+        m_ranges.push_back({indexCount, mesh.indexCount, vertexCount, mesh.vertexCount});
+        vertexCount += mesh.vertexCount;
+        indexCount += mesh.indexCount;
+    }
+
+    // rebasing may push indices of small meshes past 16 bits, only the total vertex count decides
+    const bool indices32Bit = vertexCount > std::numeric_limits<quint16>::max() + 1u;
+    m_indexFormat = indices32Bit ? QRhiCommandBuffer::IndexUInt32 : QRhiCommandBuffer::IndexUInt16;
+    const quint32 indexSize = indices32Bit ? sizeof(quint32) : sizeof(quint16);
+
+    // at least one byte each, an empty model still gets valid buffers to bind
+    m_vbuf.reset(rhi.newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer,
+                               std::max<quint32>(vertexCount * sizeof(QuantizedVertex), 1)));
+    m_vbuf->create();
+    m_ibuf.reset(rhi.newBuffer(QRhiBuffer::Immutable, QRhiBuffer::IndexBuffer,
+                               std::max<quint32>(indexCount * indexSize, 1)));
+    m_ibuf->create();
+}
+
+void SceneGeometry::upload(QRhiResourceUpdateBatch *updates, const size_t meshIndex, const CachedMesh &mesh) {
+    auto &range = m_ranges[meshIndex];
+    quint32 firstIndex = range.firstIndex;
+    for (const auto count: mesh.lodIndexCounts) {
+        range.lods.push_back({firstIndex, count});
+        firstIndex += count;
+    }
+    if (range.vertexCount == 0 || mesh.numIndices == 0) {
+        return;
+    }
+    if (mesh.numIndices > range.indexCount) {
+        std::cerr << "Mesh " << meshIndex << " does not fit its index range" << std::endl;
+        exit(1);
+    }
+
+    // vertex data is quantized ahead of time, see MeshCache
+    updates->uploadStaticBuffer(m_vbuf.get(), range.firstVertex * sizeof(QuantizedVertex),
+                                range.vertexCount * sizeof(QuantizedVertex), mesh.vertexData);
+
+    const bool indices32Bit = m_indexFormat == QRhiCommandBuffer::IndexUInt32;
+    const quint32 indexSize = indices32Bit ? sizeof(quint32) : sizeof(quint16);
+    const auto indexData = indices32Bit
+                               ? rebased<quint32>(mesh, range.firstVertex)
+                               : rebased<quint16>(mesh, range.firstVertex);
+    updates->uploadStaticBuffer(m_ibuf.get(), range.firstIndex * indexSize,
+                                static_cast<quint32>(indexData.size()), indexData.constData());
+}
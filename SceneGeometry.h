@@ -0,0 +1,61 @@
+#ifndef SCENEGEOMETRY_H
+#define SCENEGEOMETRY_H
+#include <memory>
+#include <vector>
+#include <rhi/qrhi.h>
+
+#include "MeshCache.h"
+#include "ModelLoader.h"
+
+
+// indices of one level of detail, in the shared index buffer
+struct IndexRange {
+    quint32 firstIndex = 0;
+    quint32 indexCount = 0;
+};
+
+// where the triangles of one mesh live in the shared buffers
+struct DrawRange {
+    // reserved for all levels of detail
+    quint32 firstIndex = 0;
+    quint32 indexCount = 0;
+    quint32 firstVertex = 0;
+    quint32 vertexCount = 0;
+    // full detail first, known once the mesh is uploaded
+    std::vector<IndexRange> lods;
+};
+
+// One vertex buffer and one index buffer for every mesh of the model, so the whole model is drawn with
+// a single vertex input binding and only the index range changes between draws.
+// The buffers are sized from the model layout up front and filled mesh by mesh as they finish loading.
+class SceneGeometry {
+public:
+    void allocate(QRhi &rhi, const ModelLayout &layout);
+    // queues the upload of one mesh into its range, indices are rebased onto the shared vertex buffer
+    void upload(QRhiResourceUpdateBatch *updates, size_t meshIndex, const CachedMesh &mesh);
+
+    const std::vector<DrawRange> &ranges() const {
+        return m_ranges;
+    }
+
+    QRhiBuffer *vertexBuffer() const {
+        return m_vbuf.get();
+    }
+
+    QRhiBuffer *indexBuffer() const {
+        return m_ibuf.get();
+    }
+
+    QRhiCommandBuffer::IndexFormat indexFormat() const {
+        return m_indexFormat;
+    }
+
+private:
+    std::unique_ptr<QRhiBuffer> m_vbuf;
+    std::unique_ptr<QRhiBuffer> m_ibuf;
+    QRhiCommandBuffer::IndexFormat m_indexFormat = QRhiCommandBuffer::IndexUInt16;
+    std::vector<DrawRange> m_ranges;
+};
+
+
+#endif //SCENEGEOMETRY_H
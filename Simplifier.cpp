@@ -0,0 +1,295 @@
+#include "Simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+
+#include "MeshCache.h"
+
+namespace {
+// collapses are only allowed between vertices whose normals are less than about 60 degrees apart
+constexpr float MIN_NORMAL_DOT = 0.5f;
+// a triangle whose normal turns further than about 80 degrees during a collapse counts as flipped
+constexpr float MIN_FACE_DOT = 0.2f;
+
+// symmetric 4x4 error matrix of the planes around a vertex, upper triangle row by row
+struct Quadric {
+    double m[10] = {};
+
+    void addPlane(const double n[3], const double d, const double weight) {
+        const double plane[4] = {n[0], n[1], n[2], d};
+        int k = 0;
+        for (int row = 0; row < 4; ++row) {
+            for (int column = row; column < 4; ++column) {
+                m[k++] += weight * plane[row] * plane[column];
+            }
+        }
+    }
+
+    void add(const Quadric &other) {
+        for (int k = 0; k < 10; ++k) {
+            m[k] += other.m[k];
+        }
+    }
+
+    // squared distance of p to the planes, area weighted
+    double error(const float *p) const {
+        const double x = p[0], y = p[1], z = p[2];
+        return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x +
+               m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y +
+               m[7] * z * z + 2 * m[8] * z +
+               m[9];
+    }
+};
+
+struct Collapse {
+    float cost;
+    uint32_t from;
+    uint32_t to;
+    // sum of both vertex versions when the cost was computed, stale once either vertex changed
+    uint32_t version;
+
+    bool operator>(const Collapse &other) const {
+        return cost > other.cost;
+    }
+};
+
+void cross(const float *a, const float *b, const float *c, float out[3]) {
+    const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    out[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    out[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    out[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+float dot(const float *a, const float *b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+float length(const float *a) {
+    return std::sqrt(dot(a, a));
+}
+
+// vertices sharing their position with another vertex sit on a UV seam or a hard edge
+void lockSplitVertices(const float *vertexData, const size_t vertexCount, std::vector<char> &locked) {
+    std::vector<uint32_t> order(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        order[v] = v;
+    }
+    const auto position = [&](const uint32_t v) {
+        return vertexData + static_cast<size_t>(v) * VERTEX_STRIDE;
+    };
+    std::sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) {
+        return std::memcmp(position(a), position(b), 3 * sizeof(float)) < 0;
+    });
+    for (size_t i = 1; i < order.size(); ++i) {
+        if (std::memcmp(position(order[i - 1]), position(order[i]), 3 * sizeof(float)) == 0) {
+            locked[order[i - 1]] = 1;
+            locked[order[i]] = 1;
+        }
+    }
+}
+
+// edges used by a single triangle are on an open border
+void lockBorderVertices(const std::vector<uint32_t> &indices, std::vector<char> &locked) {
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        for (int e = 0; e < 3; ++e) {
+            const uint64_t a = indices[t + e];
+            const uint64_t b = indices[t + (e + 1) % 3];
+            edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            ++j;
+        }
+        if (j - i == 1) {
+            locked[edges[i] >> 32] = 1;
+            locked[edges[i] & 0xffffffffu] = 1;
+        }
+        i = j;
+    }
+}
+}
+
+uint32_t lodIndexBudget(const uint32_t fullIndexCount, const int level) {
+    return (fullIndexCount / 3 >> level) * 3;
+}
+
+std::vector<uint32_t> simplifyMesh(const float *vertexData, const size_t vertexCount,
+                                   const std::vector<uint32_t> &indices, const size_t targetIndexCount) {
+    const auto position = [&](const uint32_t v) {
+        return vertexData + static_cast<size_t>(v) * VERTEX_STRIDE;
+    };
+    const auto normal = [&](const uint32_t v) {
+        return vertexData + static_cast<size_t>(v) * VERTEX_STRIDE + 3;
+    };
+
+    std::vector<char> locked(vertexCount, 0);
+    lockSplitVertices(vertexData, vertexCount, locked);
+    lockBorderVertices(indices, locked);
+
+    std::vector<uint32_t> triangles = indices;
+    const size_t triangleCount = triangles.size() / 3;
+    std::vector<char> triangleAlive(triangleCount, 1);
+    size_t aliveIndexCount = triangleCount * 3;
+
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        const uint32_t *corner = &triangles[3 * t];
+        for (int c = 0; c < 3; ++c) {
+            vertexTriangles[corner[c]].push_back(t);
+        }
+
+        float n[3];
+        cross(position(corner[0]), position(corner[1]), position(corner[2]), n);
+        const float doubleArea = length(n);
+        if (doubleArea <= 0.0f) {
+            continue;
+        }
+        const double unit[3] = {n[0] / doubleArea, n[1] / doubleArea, n[2] / doubleArea};
+        const float *p = position(corner[0]);
+        const double d = -(unit[0] * p[0] + unit[1] * p[1] + unit[2] * p[2]);
+        for (int c = 0; c < 3; ++c) {
+            quadrics[corner[c]].addPlane(unit, d, 0.5 * doubleArea);
+        }
+    }
+
+    std::vector<uint32_t> versions(vertexCount, 0);
+    std::vector<char> collapsed(vertexCount, 0);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+    // the cheaper direction of an edge, nothing when both ends are locked
+    const auto push = [&](const uint32_t a, const uint32_t b) {
+        const double costAToB = locked[a] ? -1.0 : quadrics[a].error(position(b)) + quadrics[b].error(position(b));
+        const double costBToA = locked[b] ? -1.0 : quadrics[a].error(position(a)) + quadrics[b].error(position(a));
+        if (costAToB < 0.0 && costBToA < 0.0) {
+            return;
+        }
+        const bool aToB = costBToA < 0.0 || (costAToB >= 0.0 && costAToB <= costBToA);
+        queue.push({
+            static_cast<float>(aToB ? costAToB : costBToA), aToB ? a : b, aToB ? b : a, versions[a] + versions[b]
+        });
+    };
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        const uint32_t *corner = &triangles[3 * t];
+        for (int e = 0; e < 3; ++e) {
+            // interior edges show up in two triangles, once in each direction
+            if (corner[e] < corner[(e + 1) % 3]) {
+                push(corner[e], corner[(e + 1) % 3]);
+            }
+        }
+    }
+
+    std::vector<uint32_t> fromNeighbours;
+    std::vector<uint32_t> toNeighbours;
+    const auto neighbours = [&](const uint32_t v, std::vector<uint32_t> &out) {
+        out.clear();
+        for (const auto t: vertexTriangles[v]) {
+            if (triangleAlive[t]) {
+                for (int c = 0; c < 3; ++c) {
+                    if (triangles[3 * t + c] != v) {
+                        out.push_back(triangles[3 * t + c]);
+                    }
+                }
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+
+    while (aliveIndexCount > targetIndexCount && !queue.empty()) {
+        const auto candidate = queue.top();
+        queue.pop();
+        const uint32_t from = candidate.from;
+        const uint32_t to = candidate.to;
+        if (collapsed[from] || collapsed[to] || candidate.version != versions[from] + versions[to]) {
+            continue;
+        }
+        if (dot(normal(from), normal(to)) < MIN_NORMAL_DOT) {
+            continue;
+        }
+
+        // the triangles around the edge are the only ones the two vertices may share, anything else folds the surface
+        neighbours(from, fromNeighbours);
+        neighbours(to, toNeighbours);
+        size_t sharedNeighbours = 0;
+        for (const auto w: fromNeighbours) {
+            sharedNeighbours += std::binary_search(toNeighbours.begin(), toNeighbours.end(), w);
+        }
+        size_t edgeTriangles = 0;
+        bool flips = false;
+        for (const auto t: vertexTriangles[from]) {
+            if (!triangleAlive[t]) {
+                continue;
+            }
+            const uint32_t *corner = &triangles[3 * t];
+            if (corner[0] == to || corner[1] == to || corner[2] == to) {
+                ++edgeTriangles;
+                continue;
+            }
+            const float *moved[3];
+            for (int c = 0; c < 3; ++c) {
+                moved[c] = position(corner[c] == from ? to : corner[c]);
+            }
+            float before[3], after[3];
+            cross(position(corner[0]), position(corner[1]), position(corner[2]), before);
+            cross(moved[0], moved[1], moved[2], after);
+            const float lengths = length(before) * length(after);
+            if (lengths <= 0.0f || dot(before, after) < MIN_FACE_DOT * lengths) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips || sharedNeighbours != edgeTriangles) {
+            continue;
+        }
+
+        for (const auto t: vertexTriangles[from]) {
+            if (!triangleAlive[t]) {
+                continue;
+            }
+            uint32_t *corner = &triangles[3 * t];
+            if (corner[0] == to || corner[1] == to || corner[2] == to) {
+                triangleAlive[t] = 0;
+                aliveIndexCount -= 3;
+                continue;
+            }
+            for (int c = 0; c < 3; ++c) {
+                if (corner[c] == from) {
+                    corner[c] = to;
+                }
+            }
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from] = {};
+        collapsed[from] = 1;
+        quadrics[to].add(quadrics[from]);
+        ++versions[to];
+
+        // drop the triangles that died on the way, then requeue every edge around the merged vertex
+        auto &around = vertexTriangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](const uint32_t t) {
+            return !triangleAlive[t];
+        }), around.end());
+        neighbours(to, toNeighbours);
+        for (const auto w: toNeighbours) {
+            push(to, w);
+        }
+    }
+
+    std::vector<uint32_t> simplified;
+    simplified.reserve(aliveIndexCount);
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        if (triangleAlive[t]) {
+            simplified.insert(simplified.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+        }
+    }
+    return simplified;
+}
@@ -0,0 +1,23 @@
+#ifndef SIMPLIFIER_H
+#define SIMPLIFIER_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// levels of detail a mesh is prepared with, full detail included
+constexpr int MAX_LOD_COUNT = 4;
+
+// most indices level (1 and up) may keep, half of the level before it
+uint32_t lodIndexBudget(uint32_t fullIndexCount, int level);
+
+// Quadric error metric simplification (Garland & Heckbert), collapsing edges onto one of their existing vertices,
+// so normals and texture coordinates are kept as they are. Vertices on UV seams or hard normals (split into several
+// vertices at one position) and on open borders never move, collapses that flip a triangle or fold a crease are skipped.
+// vertexData is interleaved with VERTEX_STRIDE floats per vertex. The result indexes the same vertices, it ends up above
+// targetIndexCount when the mesh runs out of collapses first.
+std::vector<uint32_t> simplifyMesh(const float *vertexData, size_t vertexCount, const std::vector<uint32_t> &indices,
+                                   size_t targetIndexCount);
+
+
+#endif //SIMPLIFIER_H
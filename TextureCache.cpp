@@ -0,0 +1,415 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QImage>
+#include <QStandardPaths>
+
+#include "ParallelFor.h"
+#include "assimp/texture.h"
+#include "vendor/stb_image.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TEXTURE_CACHE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr char MAGIC[4] = {'I', 'E', 'T', 'C'};
+// bump on any change to the records below, to the downsampling or to the block encoders
+constexpr quint32 FORMAT_VERSION = 1;
+// written in native byte order, a cache from a machine of the other endianness reads back differently
+constexpr quint32 BYTE_ORDER_MARK = 0x01020304;
+constexpr qint64 BLOB_ALIGNMENT = 16;
+constexpr int HASH_SIZE = 32;
+constexpr int BC1_BLOCK_SIZE = 8;
+
+struct FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 encoding;
+    quint32 width;
+    quint32 height;
+    quint32 levelCount;
+    quint32 reserved;
+    char hash[HASH_SIZE];
+    quint64 totalSize;
+};
+
+struct LevelRecord {
+    quint64 dataOffset;
+    quint64 dataSize;
+};
+
+static_assert(sizeof(FileHeader) == 72);
+static_assert(sizeof(LevelRecord) == 16);
+
+QSize levelSize(const QSize size, const int level) {
+    return {std::max(size.width() >> level, 1), std::max(size.height() >> level, 1)};
+}
+
+quint32 encodedLevelSize(const QSize size, const TextureEncoding encoding) {
+    if (encoding == TextureEncoding::BC1) {
+        return static_cast<quint32>((size.width() + 3) / 4 * ((size.height() + 3) / 4) * BC1_BLOCK_SIZE);
+    }
+    return static_cast<quint32>(size.width() * size.height() * 4);
+}
+
+// 2x2 box filter, an odd last row or column is averaged with itself
+void downsample(const uchar *src, const int srcWidth, const int srcHeight, uchar *dst) {
+    const int dstWidth = std::max(srcWidth / 2, 1);
+    const int dstHeight = std::max(srcHeight / 2, 1);
+
+    for (int y = 0; y < dstHeight; ++y) {
+        const uchar *row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+        const uchar *row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+        uchar *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+        int x = 0;
+#ifdef TEXTURE_CACHE_SSE2
+        // four output pixels from two rows of eight, summed in 16 bit lanes so it rounds like the scalar loop
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        const auto pairSums = [&](const uchar *pixels) {
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+            const __m128i lo = _mm_unpacklo_epi8(packed, zero);
+            const __m128i hi = _mm_unpackhi_epi8(packed, zero);
+            return _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)),
+                                      _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+        };
+        for (; 2 * x + 8 <= srcWidth; x += 4) {
+            const __m128i left = _mm_add_epi16(pairSums(row0 + 8 * x), pairSums(row1 + 8 * x));
+            const __m128i right = _mm_add_epi16(pairSums(row0 + 8 * x + 16), pairSums(row1 + 8 * x + 16));
+            const __m128i averaged = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(left, two), 2),
+                                                      _mm_srli_epi16(_mm_add_epi16(right, two), 2));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x), averaged);
+        }
+#endif
+        for (; x < dstWidth; ++x) {
+            const int x0 = std::min(2 * x, srcWidth - 1) * 4;
+            const int x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+            for (int c = 0; c < 4; ++c) {
+                out[4 * x + c] = static_cast<uchar>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+}
+
+quint16 to565(const int r, const int g, const int b) {
+    return static_cast<quint16>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | (b * 31 + 127) / 255);
+}
+
+void from565(const quint16 color, int rgb[3]) {
+    const int r = color >> 11 & 31;
+    const int g = color >> 5 & 63;
+    const int b = color & 31;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+// Endpoints from the bounding box of the block colors, inset by a sixteenth against outliers, its diagonal
+// flipped where green or blue fall while red rises. Every pixel then takes the closest of the four palette colors.
+void encodeBc1Block(const uchar (&pixels)[16][4], uchar *out) {
+    int minColor[3] = {255, 255, 255};
+    int maxColor[3] = {0, 0, 0};
+    int mean[3] = {0, 0, 0};
+    for (const auto &pixel: pixels) {
+        for (int c = 0; c < 3; ++c) {
+            minColor[c] = std::min<int>(minColor[c], pixel[c]);
+            maxColor[c] = std::max<int>(maxColor[c], pixel[c]);
+            mean[c] += pixel[c];
+        }
+    }
+
+    int covarianceRg = 0;
+    int covarianceRb = 0;
+    for (const auto &pixel: pixels) {
+        const int r = 16 * pixel[0] - mean[0];
+        covarianceRg += r * (16 * pixel[1] - mean[1]);
+        covarianceRb += r * (16 * pixel[2] - mean[2]);
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        const int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+    if (covarianceRg < 0) {
+        std::swap(minColor[1], maxColor[1]);
+    }
+    if (covarianceRb < 0) {
+        std::swap(minColor[2], maxColor[2]);
+    }
+
+    quint16 color0 = to565(maxColor[0], maxColor[1], maxColor[2]);
+    quint16 color1 = to565(minColor[0], minColor[1], minColor[2]);
+    // color0 > color1 selects the four color mode, the order of the endpoints does not matter otherwise
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    int palette[4][3];
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    quint32 indices = 0;
+    if (color0 != color1) {
+        for (int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            int bestDistance = std::numeric_limits<int>::max();
+            for (int p = 0; p < 4; ++p) {
+                int distance = 0;
+                for (int c = 0; c < 3; ++c) {
+                    const int d = pixels[i][c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+            indices |= static_cast<quint32>(bestIndex) << 2 * i;
+        }
+    }
+
+    // little endian, as the block format defines it
+    const uchar block[BC1_BLOCK_SIZE] = {
+        static_cast<uchar>(color0), static_cast<uchar>(color0 >> 8),
+        static_cast<uchar>(color1), static_cast<uchar>(color1 >> 8),
+        static_cast<uchar>(indices), static_cast<uchar>(indices >> 8),
+        static_cast<uchar>(indices >> 16), static_cast<uchar>(indices >> 24)
+    };
+    std::memcpy(out, block, sizeof(block));
+}
+
+// one row of 4x4 blocks, pixels past the edge of levels smaller than a block repeat the last row / column
+void encodeBc1Row(const uchar *rgba, const QSize size, const int blockRow, uchar *out) {
+    const int blocksWide = (size.width() + 3) / 4;
+    for (int blockX = 0; blockX < blocksWide; ++blockX) {
+        uchar pixels[16][4];
+        for (int y = 0; y < 4; ++y) {
+            const int sourceY = std::min(4 * blockRow + y, size.height() - 1);
+            for (int x = 0; x < 4; ++x) {
+                const int sourceX = std::min(4 * blockX + x, size.width() - 1);
+                std::memcpy(pixels[4 * y + x], rgba + (static_cast<size_t>(sourceY) * size.width() + sourceX) * 4, 4);
+            }
+        }
+        encodeBc1Block(pixels, out + static_cast<size_t>(blockX) * BC1_BLOCK_SIZE);
+    }
+}
+
+// returns the offset the blob was written at
+quint64 appendAligned(QByteArray &out, const void *data, const qint64 size) {
+    const qint64 padding = (BLOB_ALIGNMENT - out.size() % BLOB_ALIGNMENT) % BLOB_ALIGNMENT;
+    out.append(padding, '\0');
+    const auto offset = static_cast<quint64>(out.size());
+    out.append(static_cast<const char *>(data), size);
+    return offset;
+}
+}
+
+CachedTexture EncodedTexture::view() const {
+    CachedTexture texture{materialIndex, width, height, encoding, {}};
+    for (const auto &[offset, size]: levels) {
+        texture.levels.push_back({data.data() + offset, size});
+    }
+    return texture;
+}
+
+QByteArray TextureCache::hashEmbedded(const aiTexture &texture) {
+    // compressed images (png, jpg) have no height and their byte count as width
+    const qsizetype size = texture.mHeight == 0
+                               ? static_cast<qsizetype>(texture.mWidth)
+                               : static_cast<qsizetype>(texture.mWidth) * texture.mHeight * sizeof(aiTexel);
+    return QCryptographicHash::hash(QByteArrayView(reinterpret_cast<const char *>(texture.pcData), size),
+                                    QCryptographicHash::Sha256);
+}
+
+QString TextureCache::cachePathFor(const QByteArray &hash, const QSize size, const TextureEncoding encoding) {
+    const auto cacheDir = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(
+        QLatin1String("textures"));
+    const auto fileName = QString::fromLatin1(hash.toHex()) + QLatin1Char('-') + QString::number(size.width()) +
+                          QLatin1Char('x') + QString::number(size.height()) +
+                          (encoding == TextureEncoding::BC1 ? QLatin1String("-bc1") : QLatin1String("-rgba8")) +
+                          QLatin1String(".texcache");
+    return QDir(cacheDir).filePath(fileName);
+}
+
+int TextureCache::mipLevelCount(const QSize size) {
+    int levels = 1;
+    for (int extent = std::max(size.width(), size.height()); extent > 1; extent /= 2) {
+        ++levels;
+    }
+    return levels;
+}
+
+quint64 TextureCache::mipChainSize(const QSize size, const TextureEncoding encoding) {
+    quint64 bytes = 0;
+    for (int level = 0; level < mipLevelCount(size); ++level) {
+        bytes += encodedLevelSize(levelSize(size, level), encoding);
+    }
+    return bytes;
+}
+
+QSize TextureCache::layerSize(const std::vector<TextureSource> &sources, const TextureEncoding encoding) {
+    QSize size(1, 1);
+    for (const auto &source: sources) {
+        size = size.expandedTo(QSize(source.width, source.height));
+    }
+    if (encoding == TextureEncoding::BC1) {
+        // some backends want whole blocks on the top level
+        size = QSize((size.width() + 3) / 4 * 4, (size.height() + 3) / 4 * 4);
+    }
+    return size;
+}
+
+bool TextureCache::encode(const TextureSource &source, const QSize size, const TextureEncoding encoding,
+                          EncodedTexture &texture) {
+    int width, height, channels;
+    unsigned char *data = stbi_load_from_memory(
+        reinterpret_cast<unsigned char *>(source.embedded->pcData),
+        source.embedded->mWidth,
+        &width,
+        &height,
+        &channels,
+        4
+    );
+
+    if (!data) {
+        return false;
+    }
+
+    // layers of the texture array share one size, smaller textures are scaled up
+    QImage image(data, width, height, QImage::Format_RGBA8888);
+    if (image.size() != size) {
+        image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    // the full chain in RGBA8, largest level first
+    const int levelCount = mipLevelCount(size);
+    std::vector<std::vector<uchar>> chain(levelCount);
+    chain[0].resize(static_cast<size_t>(size.width()) * size.height() * 4);
+    for (int y = 0; y < size.height(); ++y) {
+        std::memcpy(chain[0].data() + static_cast<size_t>(y) * size.width() * 4, image.constScanLine(y),
+                    static_cast<size_t>(size.width()) * 4);
+    }
+    stbi_image_free(data);
+    for (size_t i = 0; i < chain[0].size(); i += 4) {
+        chain[0][i + 3] = 255; // A (fully opaque)
+    }
+    for (int level = 1; level < levelCount; ++level) {
+        const auto parentSize = levelSize(size, level - 1);
+        const auto childSize = levelSize(size, level);
+        chain[level].resize(static_cast<size_t>(childSize.width()) * childSize.height() * 4);
+        downsample(chain[level - 1].data(), parentSize.width(), parentSize.height(), chain[level].data());
+    }
+
+    texture = EncodedTexture{source.materialIndex, size.width(), size.height(), encoding, {}, {}};
+    quint32 offset = 0;
+    for (int level = 0; level < levelCount; ++level) {
+        const auto levelBytes = encodedLevelSize(levelSize(size, level), encoding);
+        texture.levels.emplace_back(offset, levelBytes);
+        offset += levelBytes;
+    }
+    texture.data.resize(offset);
+
+    if (encoding == TextureEncoding::RGBA8) {
+        for (int level = 0; level < levelCount; ++level) {
+            std::memcpy(texture.data.data() + texture.levels[level].first, chain[level].data(), chain[level].size());
+        }
+        return true;
+    }
+
+    // block rows of every level are independent of each other
+    std::vector<std::pair<int, int>> jobs;
+    for (int level = 0; level < levelCount; ++level) {
+        const int blockRows = (levelSize(size, level).height() + 3) / 4;
+        for (int blockRow = 0; blockRow < blockRows; ++blockRow) {
+            jobs.emplace_back(level, blockRow);
+        }
+    }
+    parallelFor(jobs.size(), [&](const size_t job) {
+        const auto [level, blockRow] = jobs[job];
+        const auto extent = levelSize(size, level);
+        const size_t rowBytes = static_cast<size_t>((extent.width() + 3) / 4) * BC1_BLOCK_SIZE;
+        encodeBc1Row(chain[level].data(), extent, blockRow,
+                     texture.data.data() + texture.levels[level].first + blockRow * rowBytes);
+    });
+    return true;
+}
+
+QByteArray TextureCache::serialize(const QByteArray &hash, const EncodedTexture &texture) {
+    const qint64 recordsSize = sizeof(FileHeader) + texture.levels.size() * sizeof(LevelRecord);
+    QByteArray out(recordsSize, '\0');
+
+    std::vector<LevelRecord> levelRecords;
+    for (const auto &[offset, size]: texture.levels) {
+        levelRecords.push_back({appendAligned(out, texture.data.data() + offset, size), size});
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.encoding = static_cast<quint32>(texture.encoding);
+    header.width = texture.width;
+    header.height = texture.height;
+    header.levelCount = static_cast<quint32>(levelRecords.size());
+    std::memcpy(header.hash, hash.constData(), std::min<qsizetype>(hash.size(), HASH_SIZE));
+    header.totalSize = out.size();
+
+    std::memcpy(out.data(), &header, sizeof(header));
+    std::memcpy(out.data() + sizeof(header), levelRecords.data(), levelRecords.size() * sizeof(LevelRecord));
+    return out;
+}
+
+bool TextureCache::openFile(const QString &cachePath, const QByteArray &hash, const unsigned int materialIndex,
+                            const QSize size, const TextureEncoding encoding) {
+    m_file.setFileName(cachePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    const uchar *data = m_file.map(0, fileSize);
+    if (data == nullptr || fileSize < static_cast<qint64>(sizeof(FileHeader))) {
+        m_file.close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const int levelCount = mipLevelCount(size);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+        header.byteOrderMark != BYTE_ORDER_MARK || header.encoding != static_cast<quint32>(encoding) ||
+        header.width != static_cast<quint32>(size.width()) || header.height != static_cast<quint32>(size.height()) ||
+        header.levelCount != static_cast<quint32>(levelCount) || header.totalSize != static_cast<quint64>(fileSize) ||
+        hash.size() != HASH_SIZE || std::memcmp(header.hash, hash.constData(), HASH_SIZE) != 0 ||
+        sizeof(FileHeader) + levelCount * sizeof(LevelRecord) > static_cast<quint64>(fileSize)) {
+        m_file.close();
+        return false;
+    }
+
+    m_texture = CachedTexture{materialIndex, size.width(), size.height(), encoding, {}};
+    const auto *levelRecords = reinterpret_cast<const LevelRecord *>(data + sizeof(FileHeader));
+    for (int level = 0; level < levelCount; ++level) {
+        const auto &record = levelRecords[level];
+        if (record.dataSize != encodedLevelSize(levelSize(size, level), encoding) ||
+            record.dataOffset % BLOB_ALIGNMENT != 0 || record.dataOffset > static_cast<quint64>(fileSize) ||
+            record.dataSize > static_cast<quint64>(fileSize) - record.dataOffset) {
+            m_file.close();
+            return false;
+        }
+        m_texture.levels.push_back({data + record.dataOffset, static_cast<quint32>(record.dataSize)});
+    }
+    return true;
+}
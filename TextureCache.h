@@ -0,0 +1,90 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QSize>
+#include <QString>
+
+struct aiTexture;
+
+// how the levels of a texture are stored, picked by what the graphics backend can sample
+enum class TextureEncoding : quint32 {
+    RGBA8 = 0,
+    // 4x4 blocks of 8 bytes, a sixth of RGB8 and an eighth of RGBA8
+    BC1 = 1
+};
+
+// embedded diffuse texture of a material, still encoded, size read from its header.
+// embedded is null for textures only known from the mesh cache, hash is the key into the texture cache either way
+struct TextureSource {
+    unsigned int materialIndex;
+    const aiTexture *embedded;
+    int width;
+    int height;
+    QByteArray hash;
+};
+
+// one mip level, rows of pixels for RGBA8, rows of 4x4 blocks for BC1
+struct TextureLevel {
+    const uchar *data;
+    quint32 size;
+};
+
+// full mip chain of a diffuse texture, ready to upload into its texture array layer
+struct CachedTexture {
+    unsigned int materialIndex;
+    int width;
+    int height;
+    TextureEncoding encoding;
+    std::vector<TextureLevel> levels;
+};
+
+// encoded texture owning its levels, before it is written to the cache
+struct EncodedTexture {
+    unsigned int materialIndex = 0;
+    int width = 0;
+    int height = 0;
+    TextureEncoding encoding = TextureEncoding::RGBA8;
+    std::vector<uchar> data;
+    // offset into data and size of every level, largest first
+    std::vector<std::pair<quint32, quint32>> levels;
+
+    CachedTexture view() const;
+};
+
+// Decoded, mipmapped and block-compressed diffuse textures, one file per texture in the per user cache directory,
+// keyed by the hash of the embedded image together with the size and encoding it was prepared for.
+// A hit skips image decoding entirely, the file is mapped and its levels uploaded straight from the mapping.
+class TextureCache {
+public:
+    static QByteArray hashEmbedded(const aiTexture &texture);
+    static QString cachePathFor(const QByteArray &hash, QSize size, TextureEncoding encoding);
+    // down to 1x1
+    static int mipLevelCount(QSize size);
+    // bytes of every level together
+    static quint64 mipChainSize(QSize size, TextureEncoding encoding);
+    // size every layer of the texture array gets, block aligned for block-compressed encodings
+    static QSize layerSize(const std::vector<TextureSource> &sources, TextureEncoding encoding);
+
+    // decodes the embedded image, scales it to size, builds the mip chain and encodes every level,
+    // false when the image cannot be decoded
+    static bool encode(const TextureSource &source, QSize size, TextureEncoding encoding, EncodedTexture &texture);
+    static QByteArray serialize(const QByteArray &hash, const EncodedTexture &texture);
+
+    // maps the cache file, false when it is missing, damaged or of another format version
+    bool openFile(const QString &cachePath, const QByteArray &hash, unsigned int materialIndex, QSize size,
+                  TextureEncoding encoding);
+
+    const CachedTexture &texture() const {
+        return m_texture;
+    }
+
+private:
+    // keeps the mapping alive, m_texture points into it
+    QFile m_file;
+    CachedTexture m_texture{};
+};
+
+
+#endif //TEXTURECACHE_H
@@ -0,0 +1,316 @@
+#include "TriangleSoa.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRIANGLE_SOA_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+constexpr float EPSILON = 1e-6;
+
+// the vector kernels load full registers past the end of a range, lanes outside of it are masked out
+constexpr size_t STREAM_PADDING = 8;
+
+// ray origin xyz followed by ray direction xyz
+using IntersectKernel = bool (*)(const float *const *streams, const float *ray,
+                                 size_t first, size_t count, float &closestDistance);
+
+bool intersectScalar(const float *const *streams, const float *ray,
+                     const size_t first, const size_t count, float &closestDistance) {
+    bool hit = false;
+    for (size_t i = first; i < first + count; ++i) {
+        const float e1x = streams[TriangleSoa::EDGE1_X][i];
+        const float e1y = streams[TriangleSoa::EDGE1_Y][i];
+        const float e1z = streams[TriangleSoa::EDGE1_Z][i];
+        const float e2x = streams[TriangleSoa::EDGE2_X][i];
+        const float e2y = streams[TriangleSoa::EDGE2_Y][i];
+        const float e2z = streams[TriangleSoa::EDGE2_Z][i];
+
+        const float hx = ray[4] * e2z - ray[5] * e2y;
+        const float hy = ray[5] * e2x - ray[3] * e2z;
+        const float hz = ray[3] * e2y - ray[4] * e2x;
+        const float a = e1x * hx + e1y * hy + e1z * hz;
+        if (std::fabs(a) < EPSILON) {
+            continue;
+        }
+
+        const float f = 1.0f / a;
+        const float sx = ray[0] - streams[TriangleSoa::V0_X][i];
+        const float sy = ray[1] - streams[TriangleSoa::V0_Y][i];
+        const float sz = ray[2] - streams[TriangleSoa::V0_Z][i];
+        const float u = f * (sx * hx + sy * hy + sz * hz);
+        if (u < 0.0f || u > 1.0f) {
+            continue;
+        }
+
+        const float qx = sy * e1z - sz * e1y;
+        const float qy = sz * e1x - sx * e1z;
+        const float qz = sx * e1y - sy * e1x;
+        const float v = f * (ray[3] * qx + ray[4] * qy + ray[5] * qz);
+        if (v < 0.0f || u + v > 1.0f) {
+            continue;
+        }
+
+        const float t = f * (e2x * qx + e2y * qy + e2z * qz);
+        if (t > EPSILON && t < closestDistance) {
+            closestDistance = t;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+#ifdef TRIANGLE_SOA_X86
+bool intersectSse(const float *const *streams, const float *ray,
+                  const size_t first, const size_t count, float &closestDistance) {
+    const __m128 ox = _mm_set1_ps(ray[0]);
+    const __m128 oy = _mm_set1_ps(ray[1]);
+    const __m128 oz = _mm_set1_ps(ray[2]);
+    const __m128 dx = _mm_set1_ps(ray[3]);
+    const __m128 dy = _mm_set1_ps(ray[4]);
+    const __m128 dz = _mm_set1_ps(ray[5]);
+    const __m128 epsilon = _mm_set1_ps(EPSILON);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3);
+
+    __m128 best = _mm_set1_ps(closestDistance);
+
+    for (size_t i = 0; i < count; i += 4) {
+        const size_t at = first + i;
+        const __m128 e1x = _mm_loadu_ps(streams[TriangleSoa::EDGE1_X] + at);
+        const __m128 e1y = _mm_loadu_ps(streams[TriangleSoa::EDGE1_Y] + at);
+        const __m128 e1z = _mm_loadu_ps(streams[TriangleSoa::EDGE1_Z] + at);
+        const __m128 e2x = _mm_loadu_ps(streams[TriangleSoa::EDGE2_X] + at);
+        const __m128 e2y = _mm_loadu_ps(streams[TriangleSoa::EDGE2_Y] + at);
+        const __m128 e2z = _mm_loadu_ps(streams[TriangleSoa::EDGE2_Z] + at);
+
+        const __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+        __m128 valid = _mm_cmpge_ps(_mm_and_ps(a, absMask), epsilon);
+
+        const __m128 f = _mm_div_ps(one, a);
+        const __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(streams[TriangleSoa::V0_X] + at));
+        const __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(streams[TriangleSoa::V0_Y] + at));
+        const __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(streams[TriangleSoa::V0_Z] + at));
+        const __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)),
+                                                  _mm_mul_ps(sz, hz)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        const __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                                                  _mm_mul_ps(dz, qz)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+        const __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                                                  _mm_mul_ps(e2z, qz)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, epsilon), _mm_cmplt_ps(t, best)));
+
+        if (count - i < 4) {
+            const __m128i remaining = _mm_set1_epi32(static_cast<int>(count - i));
+            valid = _mm_and_ps(valid, _mm_castsi128_ps(_mm_cmplt_epi32(laneIndex, remaining)));
+        }
+
+        best = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, best));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, best);
+    const float closest = *std::min_element(lanes, lanes + 4);
+    if (closest < closestDistance) {
+        closestDistance = closest;
+        return true;
+    }
+    return false;
+}
+
+TARGET_AVX2
+bool intersectAvx2(const float *const *streams, const float *ray,
+                   const size_t first, const size_t count, float &closestDistance) {
+    const __m256 ox = _mm256_set1_ps(ray[0]);
+    const __m256 oy = _mm256_set1_ps(ray[1]);
+    const __m256 oz = _mm256_set1_ps(ray[2]);
+    const __m256 dx = _mm256_set1_ps(ray[3]);
+    const __m256 dy = _mm256_set1_ps(ray[4]);
+    const __m256 dz = _mm256_set1_ps(ray[5]);
+    const __m256 epsilon = _mm256_set1_ps(EPSILON);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 best = _mm256_set1_ps(closestDistance);
+
+    for (size_t i = 0; i < count; i += 8) {
+        const size_t at = first + i;
+        const __m256 e1x = _mm256_loadu_ps(streams[TriangleSoa::EDGE1_X] + at);
+        const __m256 e1y = _mm256_loadu_ps(streams[TriangleSoa::EDGE1_Y] + at);
+        const __m256 e1z = _mm256_loadu_ps(streams[TriangleSoa::EDGE1_Z] + at);
+        const __m256 e2x = _mm256_loadu_ps(streams[TriangleSoa::EDGE2_X] + at);
+        const __m256 e2y = _mm256_loadu_ps(streams[TriangleSoa::EDGE2_Y] + at);
+        const __m256 e2z = _mm256_loadu_ps(streams[TriangleSoa::EDGE2_Z] + at);
+
+        const __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        const __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        const __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)),
+                                       _mm256_mul_ps(e1z, hz));
+        __m256 valid = _mm256_cmp_ps(_mm256_and_ps(a, absMask), epsilon, _CMP_GE_OQ);
+
+        const __m256 f = _mm256_div_ps(one, a);
+        const __m256 sx = _mm256_sub_ps(ox, _mm256_loadu_ps(streams[TriangleSoa::V0_X] + at));
+        const __m256 sy = _mm256_sub_ps(oy, _mm256_loadu_ps(streams[TriangleSoa::V0_Y] + at));
+        const __m256 sz = _mm256_sub_ps(oz, _mm256_loadu_ps(streams[TriangleSoa::V0_Z] + at));
+        const __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)),
+                                                        _mm256_mul_ps(sz, hz)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                   _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+        const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        const __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                                                        _mm256_mul_ps(dz, qz)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                                   _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+        const __m256 t = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+                                                        _mm256_mul_ps(e2z, qz)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, epsilon, _CMP_GT_OQ),
+                                                   _mm256_cmp_ps(t, best, _CMP_LT_OQ)));
+
+        if (count - i < 8) {
+            const __m256i remaining = _mm256_set1_epi32(static_cast<int>(count - i));
+            valid = _mm256_and_ps(valid, _mm256_castsi256_ps(_mm256_cmpgt_epi32(remaining, laneIndex)));
+        }
+
+        best = _mm256_blendv_ps(best, t, valid);
+    }
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, best);
+    const float closest = *std::min_element(lanes, lanes + 8);
+    if (closest < closestDistance) {
+        closestDistance = closest;
+        return true;
+    }
+    return false;
+}
+
+bool cpuSupportsAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+    if (!osSavesYmm) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuSupportsSse2() {
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return info[3] & (1 << 26);
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
+
+struct Kernel {
+    IntersectKernel function;
+    const char *name;
+};
+
+const Kernel &selectedKernel() {
+    static const Kernel kernel = [] {
+#ifdef TRIANGLE_SOA_X86
+        if (cpuSupportsAvx2()) {
+            return Kernel{intersectAvx2, "avx2"};
+        }
+        if (cpuSupportsSse2()) {
+            return Kernel{intersectSse, "sse"};
+        }
+#endif
+        return Kernel{intersectScalar, "scalar"};
+    }();
+    return kernel;
+}
+}
+
+void TriangleSoa::build(const std::vector<QVector3D> &positions, const std::vector<uint32_t> &indices) {
+    m_count = indices.size() / 3;
+
+    for (auto &stream: m_streams) {
+        stream.assign(m_count + STREAM_PADDING, 0.0f);
+    }
+
+    for (size_t i = 0; i < m_count; ++i) {
+        const auto v0 = positions[indices[3 * i]];
+        const auto edge1 = positions[indices[3 * i + 1]] - v0;
+        const auto edge2 = positions[indices[3 * i + 2]] - v0;
+
+        m_streams[V0_X][i] = v0.x();
+        m_streams[V0_Y][i] = v0.y();
+        m_streams[V0_Z][i] = v0.z();
+        m_streams[EDGE1_X][i] = edge1.x();
+        m_streams[EDGE1_Y][i] = edge1.y();
+        m_streams[EDGE1_Z][i] = edge1.z();
+        m_streams[EDGE2_X][i] = edge2.x();
+        m_streams[EDGE2_Y][i] = edge2.y();
+        m_streams[EDGE2_Z][i] = edge2.z();
+    }
+}
+
+size_t TriangleSoa::memoryBytes() const {
+    size_t bytes = 0;
+    for (const auto &stream: m_streams) {
+        bytes += stream.capacity() * sizeof(float);
+    }
+    return bytes;
+}
+
+bool TriangleSoa::intersect(const QVector3D rayOrigin, const QVector3D rayDir, const size_t first, const size_t count,
+                            float &closestDistance) const {
+    if (count == 0) {
+        return false;
+    }
+
+    std::array<const float *, STREAM_COUNT> streams;
+    for (int i = 0; i < STREAM_COUNT; ++i) {
+        streams[i] = m_streams[i].data();
+    }
+    const float ray[] = {
+        rayOrigin.x(), rayOrigin.y(), rayOrigin.z(),
+        rayDir.x(), rayDir.y(), rayDir.z()
+    };
+
+    return selectedKernel().function(streams.data(), ray, first, count, closestDistance);
+}
+
+const char *TriangleSoa::kernelName() {
+    return selectedKernel().name;
+}
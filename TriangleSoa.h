@@ -0,0 +1,44 @@
+#ifndef TRIANGLESOA_H
+#define TRIANGLESOA_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <qvectornd.h>
+
+
+// Structure-of-arrays copy of a triangle soup with the Möller–Trumbore inputs (v0, edge1, edge2) precomputed,
+// so that several triangles can be tested against a ray at once with SSE / AVX2.
+class TriangleSoa {
+public:
+    enum Stream {
+        V0_X, V0_Y, V0_Z,
+        EDGE1_X, EDGE1_Y, EDGE1_Z,
+        EDGE2_X, EDGE2_Y, EDGE2_Z,
+        STREAM_COUNT
+    };
+
+    // gathers the triangles of an indexed mesh, three indices per triangle
+    void build(const std::vector<QVector3D> &positions, const std::vector<uint32_t> &indices);
+
+    size_t size() const {
+        return m_count;
+    }
+
+    // heap memory of the streams
+    size_t memoryBytes() const;
+
+    // Tests triangles [first, first + count), lowers closestDistance and returns true on a closer hit.
+    // Same acceptance rules as doesRayIntersectTriangle.
+    bool intersect(QVector3D rayOrigin, QVector3D rayDir, size_t first, size_t count, float &closestDistance) const;
+
+    // kernel picked at runtime for this CPU: "avx2", "sse" or "scalar"
+    static const char *kernelName();
+
+private:
+    std::array<std::vector<float>, STREAM_COUNT> m_streams;
+    size_t m_count = 0;
+};
+
+
+#endif //TRIANGLESOA_H
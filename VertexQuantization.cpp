@@ -0,0 +1,135 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "MeshCache.h"
+
+namespace {
+constexpr float POSITION_STEPS = 65535.0f;
+constexpr float NORMAL_STEPS = 32767.0f;
+// a 16 bit octahedral normal is off by less than 0.0001 radians, this leaves room for float rounding
+constexpr float MAX_NORMAL_ANGLE = 0.0002f;
+// relative rounding error of half floats, 11 bits of mantissa
+constexpr float HALF_EPSILON = 1.0f / 2048.0f;
+// smallest normal half float, below it the rounding step stays the same
+constexpr float HALF_MIN_NORMAL = 1.0f / 16384.0f;
+constexpr float HALF_MAX = 65504.0f;
+
+// unit vector onto the octahedron and that onto [-1, 1]^2, the lower half folded over the diagonals
+void octahedralEncode(const float *normal, float &x, float &y) {
+    const float sum = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    if (sum == 0.0f) {
+        x = 0.0f;
+        y = 0.0f;
+        return;
+    }
+    x = normal[0] / sum;
+    y = normal[1] / sum;
+    if (normal[2] < 0.0f) {
+        const float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+}
+
+// as color.vert does it
+QVector3D octahedralDecode(const float x, const float y) {
+    QVector3D normal(x, y, 1.0f - std::abs(x) - std::abs(y));
+    const float fold = std::max(-normal.z(), 0.0f);
+    normal.setX(normal.x() + (normal.x() >= 0.0f ? -fold : fold));
+    normal.setY(normal.y() + (normal.y() >= 0.0f ? -fold : fold));
+    return normal.normalized();
+}
+}
+
+size_t sanitizeVertices(float *vertexData, const size_t vertexCount) {
+    size_t sanitized = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        float *vertex = vertexData + v * VERTEX_STRIDE;
+        bool changed = false;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!std::isfinite(vertex[axis])) {
+                vertex[axis] = 0.0f;
+                changed = true;
+            }
+        }
+        if (!std::isfinite(vertex[3]) || !std::isfinite(vertex[4]) || !std::isfinite(vertex[5])) {
+            vertex[3] = 0.0f;
+            vertex[4] = 0.0f;
+            vertex[5] = 1.0f;
+            changed = true;
+        }
+        for (int i = 6; i < 8; ++i) {
+            const float texCoord = std::isfinite(vertex[i]) ? std::clamp(vertex[i], -HALF_MAX, HALF_MAX) : 0.0f;
+            changed |= texCoord != vertex[i];
+            vertex[i] = texCoord;
+        }
+        sanitized += changed ? 1 : 0;
+    }
+    return sanitized;
+}
+
+bool quantizeVertices(const float *vertexData, const size_t vertexCount, std::vector<QuantizedVertex> &vertices,
+                      PositionDequantization &dequantization) {
+    QVector3D min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max());
+    QVector3D max(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::lowest());
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float *vertex = vertexData + v * VERTEX_STRIDE;
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], vertex[axis]);
+            max[axis] = std::max(max[axis], vertex[axis]);
+        }
+    }
+    if (vertexCount == 0) {
+        min = max = QVector3D();
+    }
+    dequantization.offset = min;
+    dequantization.scale = (max - min) / POSITION_STEPS;
+
+    // the sine, as the cosine of angles that small is 1 in float
+    const float maxNormalSine = std::sin(MAX_NORMAL_ANGLE);
+
+    bool withinBound = true;
+    vertices.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float *vertex = vertexData + v * VERTEX_STRIDE;
+        auto &quantized = vertices[v];
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const float scale = dequantization.scale[axis];
+            const float steps = scale > 0.0f ? std::round((vertex[axis] - min[axis]) / scale) : 0.0f;
+            quantized.position[axis] = static_cast<quint16>(std::clamp(steps, 0.0f, POSITION_STEPS));
+        }
+        quantized.position[3] = 0;
+
+        float x, y;
+        octahedralEncode(vertex + 3, x, y);
+        quantized.normal[0] = static_cast<qint16>(std::round(std::clamp(x, -1.0f, 1.0f) * NORMAL_STEPS));
+        quantized.normal[1] = static_cast<qint16>(std::round(std::clamp(y, -1.0f, 1.0f) * NORMAL_STEPS));
+        // a degenerate normal has no direction to keep
+        const QVector3D normal(vertex[3], vertex[4], vertex[5]);
+        if (normal.lengthSquared() > 0.0f) {
+            const auto decoded = octahedralDecode(quantized.normal[0] / NORMAL_STEPS, quantized.normal[1] / NORMAL_STEPS);
+            withinBound &= QVector3D::dotProduct(decoded, normal) > 0.0f &&
+                           QVector3D::crossProduct(decoded, normal.normalized()).length() <= maxNormalSine;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            const float texCoord = vertex[6 + i];
+            quantized.texCoords[i] = qfloat16(texCoord);
+            const float bound = std::max(std::abs(texCoord), HALF_MIN_NORMAL) * HALF_EPSILON;
+            withinBound &= std::abs(static_cast<float>(quantized.texCoords[i]) - texCoord) <= bound;
+        }
+    }
+    return withinBound;
+}
+
+QVector3D dequantizePosition(const QuantizedVertex &vertex, const PositionDequantization &dequantization) {
+    return dequantization.offset + QVector3D(vertex.position[0], vertex.position[1], vertex.position[2]) *
+                                   dequantization.scale;
+}
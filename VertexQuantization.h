@@ -0,0 +1,42 @@
+#ifndef VERTEXQUANTIZATION_H
+#define VERTEXQUANTIZATION_H
+#include <cstddef>
+#include <vector>
+#include <QFloat16>
+#include <qvectornd.h>
+
+
+// Vertex as the GPU gets it, 16 bytes instead of the 32 of the interleaved floats: the position in 16 bit steps across
+// the bounding box of its mesh, the normal octahedral encoded in two signed 16 bit values, the UV as half floats.
+// The shader reads it as four 32 bit words and unpacks the halves, in the little endian order of the cache.
+struct QuantizedVertex {
+    // w is unused
+    quint16 position[4];
+    qint16 normal[2];
+    qfloat16 texCoords[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16);
+
+// maps the 16 bit positions of one mesh back to model space, position = offset + quantized * scale
+struct PositionDequantization {
+    QVector3D offset;
+    QVector3D scale;
+};
+
+// Replaces what the quantized format can't hold, in vertices interleaved as in MeshCache: non-finite positions and UVs
+// become 0, non-finite normals +z, UVs are clamped to the half float range. Returns how many vertices it changed.
+size_t sanitizeVertices(float *vertexData, size_t vertexCount);
+
+// Quantizes vertices interleaved as in MeshCache (VERTEX_STRIDE floats each), all of them finite (see
+// sanitizeVertices). Positions are within half a step by construction, normals and UVs are decoded again and checked
+// against the error the format allows: 0.0002 radians of normal and half float rounding of the UV. False when one is
+// past it, every vertex is quantized either way.
+bool quantizeVertices(const float *vertexData, size_t vertexCount, std::vector<QuantizedVertex> &vertices,
+                      PositionDequantization &dequantization);
+
+// as color.vert does it
+QVector3D dequantizePosition(const QuantizedVertex &vertex, const PositionDequantization &dequantization);
+
+
+#endif //VERTEXQUANTIZATION_H
@@ -0,0 +1,452 @@
+// CPU micro-benchmarks of the hot paths outside rendering, on synthetic meshes from 10k to 10M triangles so scaling
+// shows, and on the real model for the import. Build in Release, see the README.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QMatrix4x4>
+#include <assimp/Exporter.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/SpatialHashGrid.h>
+#include <assimp/SpatialSort.h>
+#include <assimp/config.h>
+
+#include "Camera.h"
+#include "MappedIOSystem.h"
+#include "MeshCache.h"
+#include "ModelLoader.h"
+#include "Picking.h"
+#include "TextureCache.h"
+#include "assimp/scene.h"
+#include "util.h"
+#include "vendor/easing/easing.h"
+
+namespace {
+
+// results are folded into it so the measured work cannot be optimized away
+volatile double g_sink = 0.0;
+
+struct BenchOptions {
+    QString filter;
+    double minMillis = 500.0;
+    qint64 maxTriangles = 10000000;
+};
+
+// Calls body until minMillis have passed (at least once) and prints the mean time per call, with the throughput
+// when items (triangles, pixels, calls) is given
+void run(const BenchOptions &options, const QString &name, const QString &size, const double items,
+         const std::function<void()> &body) {
+    if (!options.filter.isEmpty() && !name.contains(options.filter)) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    qint64 elapsedNanos = 0;
+    int iterations = 0;
+    do {
+        timer.start();
+        body();
+        elapsedNanos += timer.nsecsElapsed();
+        ++iterations;
+    } while (elapsedNanos < options.minMillis * 1e6);
+
+    const double nanosPerCall = static_cast<double>(elapsedNanos) / iterations;
+    std::cout << QString::asprintf("%-28s %10s %8d %14.3f", qPrintable(name), qPrintable(size), iterations,
+                                   nanosPerCall / 1e6).toStdString();
+    if (items > 0.0) {
+        std::cout << QString::asprintf(" %14.2f", items / nanosPerCall * 1e3).toStdString();
+    }
+    std::cout << std::endl;
+}
+
+QString triangleLabel(const qint64 triangles) {
+    return triangles >= 1000000 ? QString::number(triangles / 1000000) + QLatin1String("M")
+                                : QString::number(triangles / 1000) + QLatin1String("k");
+}
+
+// Wavy grid in the xy plane facing +z, the size of the model after the /1000 of prepareMesh. Rows of quads split into
+// two triangles, so about as many vertices as half the triangles, indexed the way the importer delivers them.
+std::unique_ptr<aiMesh> syntheticMesh(const qint64 triangles) {
+    const auto side = static_cast<unsigned int>(std::max(2.0, std::ceil(std::sqrt(triangles / 2.0)) + 1));
+    auto mesh = std::make_unique<aiMesh>();
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumVertices = side * side;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+    mesh->mNumUVComponents[0] = 2;
+    for (unsigned int y = 0; y < side; ++y) {
+        for (unsigned int x = 0; x < side; ++x) {
+            const float u = static_cast<float>(x) / (side - 1);
+            const float v = static_cast<float>(y) / (side - 1);
+            const float height = 0.05f * std::sin(u * 20.0f) * std::cos(v * 20.0f);
+            const unsigned int vertex = y * side + x;
+            mesh->mVertices[vertex] = aiVector3D((u - 0.5f) * 1000.0f, (v - 0.5f) * 1000.0f, height * 1000.0f);
+            mesh->mNormals[vertex] = aiVector3D(0.0f, 0.0f, 1.0f);
+            mesh->mTextureCoords[0][vertex] = aiVector3D(u, v, 0.0f);
+        }
+    }
+
+    const auto quads = static_cast<unsigned int>(std::min<qint64>(triangles / 2, (side - 1) * (side - 1)));
+    mesh->mNumFaces = quads * 2;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (unsigned int quad = 0; quad < quads; ++quad) {
+        const unsigned int x = quad % (side - 1);
+        const unsigned int y = quad / (side - 1);
+        const unsigned int corner = y * side + x;
+        const unsigned int corners[2][3] = {
+            {corner, corner + 1, corner + side + 1},
+            {corner, corner + side + 1, corner + side}
+        };
+        for (int half = 0; half < 2; ++half) {
+            auto &face = mesh->mFaces[2 * quad + half];
+            face.mNumIndices = 3;
+            face.mIndices = new unsigned int[3]{corners[half][0], corners[half][1], corners[half][2]};
+        }
+    }
+    return mesh;
+}
+
+// rays from in front of the grid towards random points on it, most of them hit
+std::vector<std::pair<QVector3D, QVector3D>> syntheticRays(const int count) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> coordinate(-0.55f, 0.55f);
+    std::vector<std::pair<QVector3D, QVector3D>> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QVector3D origin(coordinate(random), coordinate(random), 2.0f);
+        const QVector3D target(coordinate(random), coordinate(random), 0.0f);
+        rays.emplace_back(origin, (target - origin).normalized());
+    }
+    return rays;
+}
+
+void benchmarkMeshes(const BenchOptions &options) {
+    for (qint64 triangles = 10000; triangles <= options.maxTriangles; triangles *= 10) {
+        const QString size = triangleLabel(triangles);
+        const auto mesh = syntheticMesh(triangles);
+        const auto prepared = MeshCache::prepareMesh(*mesh);
+        const auto &picking = *prepared.picking;
+        const auto &positions = picking.positions();
+        const auto &indices = picking.indices();
+        const auto triangleCount = static_cast<double>(indices.size() / 3);
+        const auto rays = syntheticRays(64);
+
+        // one ray against every triangle through the scalar test, as the linear reference pick does
+        run(options, QStringLiteral("rayTriangle/scalar"), size, triangleCount, [&] {
+            const auto &[origin, dir] = rays.front();
+            float closest = std::numeric_limits<float>::max();
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                const auto hit = doesRayIntersectTriangle(origin, dir, positions[indices[i]],
+                                                          positions[indices[i + 1]], positions[indices[i + 2]]);
+                if (hit.has_value() && hit.value() < closest) {
+                    closest = hit.value();
+                }
+            }
+            g_sink = g_sink + closest;
+        });
+        run(options, QStringLiteral("rayTriangle/vectorized"), size, triangleCount, [&] {
+            const auto &[origin, dir] = rays.front();
+            float closest = std::numeric_limits<float>::max();
+            picking.triangles().intersect(origin, dir, 0, picking.triangles().size(), closest);
+            g_sink = g_sink + closest;
+        });
+
+        // the whole picking path per ray, from the scene down to the triangles
+        const PickingScene scene({prepared.picking});
+        run(options, QStringLiteral("pick/linear"), size, static_cast<double>(rays.size()), [&] {
+            for (const auto &[origin, dir]: rays) {
+                g_sink = g_sink + scene.pickLinear(origin, dir).distance;
+            }
+        });
+        run(options, QStringLiteral("pick/bvh"), size, static_cast<double>(rays.size()), [&] {
+            for (const auto &[origin, dir]: rays) {
+                g_sink = g_sink + scene.pick(origin, dir).distance;
+            }
+        });
+
+        run(options, QStringLiteral("pickingGeometry/build"), size, triangleCount, [&] {
+            const PickingGeometry geometry(positions, indices);
+            g_sink = g_sink + geometry.bvhNodes().size();
+        });
+        // interleaving and quantizing the vertices, the centroid, the picking hierarchy and the levels of detail, as on import
+        run(options, QStringLiteral("prepareMesh"), size, triangleCount, [&] {
+            const auto preparedAgain = MeshCache::prepareMesh(*mesh);
+            g_sink = g_sink + preparedAgain.vertexData.size();
+        });
+    }
+}
+
+// The lookup of close vertices behind assimp's smooth normals and tangents, over the corners of the grid unindexed
+// as importers deliver them before joining, so every position is there six times. Built and queried once per corner
+// within 1e-4 of the bounding box diagonal, as the post-processing steps do: the sort along a plane assimp shipped
+// with against the hash grid replacing it
+void benchmarkSpatialIndex(const BenchOptions &options) {
+    for (qint64 triangles = 10000; triangles <= options.maxTriangles; triangles *= 10) {
+        const QString size = triangleLabel(triangles);
+        const auto mesh = syntheticMesh(triangles);
+        std::vector<aiVector3D> corners;
+        corners.reserve(mesh->mNumFaces * 3);
+        aiVector3D min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+        for (unsigned int face = 0; face < mesh->mNumFaces; ++face) {
+            for (unsigned int corner = 0; corner < 3; ++corner) {
+                const aiVector3D &position = mesh->mVertices[mesh->mFaces[face].mIndices[corner]];
+                corners.push_back(position);
+                min = aiVector3D(std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z));
+                max = aiVector3D(std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z));
+            }
+        }
+        const auto count = static_cast<unsigned int>(corners.size());
+        const float epsilon = (max - min).Length() * 1e-4f;
+
+        run(options, QStringLiteral("spatialIndex/sort"), size, count, [&] {
+            Assimp::SpatialSort sort;
+            sort.Fill(corners.data(), count, sizeof(aiVector3D));
+            std::vector<unsigned int> found;
+            size_t total = 0;
+            for (const auto &position: corners) {
+                sort.FindPositions(position, epsilon, found);
+                total += found.size();
+            }
+            g_sink = g_sink + total;
+        });
+        run(options, QStringLiteral("spatialIndex/hashGrid"), size, count, [&] {
+            Assimp::SpatialHashGrid grid;
+            grid.Fill(corners.data(), count, sizeof(aiVector3D), Assimp::SpatialHashGrid::CellSizeForRadius(epsilon));
+            std::vector<unsigned int> found;
+            size_t total = 0;
+            for (const auto &position: corners) {
+                grid.FindPositions(position, epsilon, found);
+                total += found.size();
+            }
+            g_sink = g_sink + total;
+        });
+    }
+}
+
+// a noisy RGB image stored as PNG, the way embedded textures arrive
+QByteArray syntheticPng(const int size) {
+    QImage image(size, size, QImage::Format_RGB888);
+    std::mt19937 random(1);
+    for (int y = 0; y < size; ++y) {
+        uchar *line = image.scanLine(y);
+        for (int x = 0; x < size * 3; ++x) {
+            line[x] = static_cast<uchar>((x + y) / 4 + random() % 32);
+        }
+    }
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return png;
+}
+
+void benchmarkTextures(const BenchOptions &options) {
+    for (const int size: {512, 1024, 2048, 4096}) {
+        const QByteArray png = syntheticPng(size);
+        // compressed embedded texture: mWidth holds the byte count, pcData the file, owned by the aiTexture
+        aiTexture texture;
+        texture.mWidth = static_cast<unsigned int>(png.size());
+        texture.mHeight = 0;
+        texture.pcData = new aiTexel[(png.size() + sizeof(aiTexel) - 1) / sizeof(aiTexel)];
+        std::memcpy(texture.pcData, png.constData(), png.size());
+        const TextureSource source{0, &texture, size, size, {}};
+        const QString label = QString::number(size) + QLatin1String("px");
+        const double pixels = static_cast<double>(size) * size;
+
+        // decoding, RGB to RGBA expansion and the mip chain, then block compression for BC1
+        run(options, QStringLiteral("textureEncode/rgba8"), label, pixels, [&] {
+            EncodedTexture encoded;
+            TextureCache::encode(source, QSize(size, size), TextureEncoding::RGBA8, encoded);
+            g_sink = g_sink + encoded.data.size();
+        });
+        run(options, QStringLiteral("textureEncode/bc1"), label, pixels, [&] {
+            EncodedTexture encoded;
+            TextureCache::encode(source, QSize(size, size), TextureEncoding::BC1, encoded);
+            g_sink = g_sink + encoded.data.size();
+        });
+    }
+}
+
+void benchmarkPerFrame(const BenchOptions &options) {
+    constexpr int CALLS = 100000;
+
+    Camera camera;
+    run(options, QStringLiteral("camera/view"), QString::number(CALLS), CALLS, [&] {
+        for (int i = 0; i < CALLS; ++i) {
+            camera.setLookAt(QVector3D(0, 0, 2.5f + i * 1e-6f), QVector3D(0, 0, 0), QVector3D(0, 1, 0));
+            g_sink = g_sink + camera.view()(0, 0);
+        }
+    });
+
+    for (const auto function: {EaseOutCubic, EaseInOutElastic}) {
+        const auto easing = getEasingFunction(function);
+        run(options, function == EaseOutCubic ? QStringLiteral("easing/outCubic") : QStringLiteral("easing/inOutElastic"),
+            QString::number(CALLS), CALLS, [&] {
+                double sum = 0.0;
+                for (int i = 0; i < CALLS; ++i) {
+                    sum += easing(static_cast<double>(i) / CALLS);
+                }
+                g_sink = g_sink + sum;
+            });
+    }
+}
+
+void benchmarkImport(const BenchOptions &options, const QString &modelPath) {
+    if (!QFileInfo::exists(modelPath)) {
+        std::cout << "Skipping the import, " << modelPath.toStdString() << " does not exist" << std::endl;
+        return;
+    }
+    // a fresh importer every time, as the app starts without a mesh cache. The zlib-compressed arrays of binary
+    // FBX inflated while parsing, as before, against inflated on all cores, then also read through a memory mapping
+    // and last with the meshes post-processed on 1, 2, 4, ... threads up to the core count, as the app imports
+    struct ImportVariant {
+        QString name;
+        bool parallelInflate;
+        bool mapped;
+        int postProcessThreads;
+    };
+    std::vector<ImportVariant> variants{{QLatin1String("import/readFile/serialInflate"), false, false, 1},
+                                        {QLatin1String("import/readFile/parallelInflate"), true, false, 1},
+                                        {QLatin1String("import/readFile/parallelInflate/mapped"), true, true, 1}};
+    const int cores = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    for (int threads = 1;; threads = std::min(threads * 2, cores)) {
+        variants.push_back({QStringLiteral("import/postProcess/threads%1").arg(threads), true, true, threads});
+        if (threads == cores)
+            break;
+    }
+    for (const auto &variant: variants) {
+        run(options, variant.name, QFileInfo(modelPath).fileName(), 0.0, [&] {
+            Assimp::Importer importer;
+            importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PARALLEL_INFLATE, variant.parallelInflate);
+            importer.SetPropertyInteger(AI_CONFIG_PP_THREAD_COUNT, variant.postProcessThreads);
+            if (variant.mapped) {
+                importer.SetIOHandler(new MappedIOSystem);
+            }
+            const aiScene *scene = importer.ReadFile(modelPath.toStdString(), MODEL_IMPORT_FLAGS);
+            if (!scene) {
+                std::cerr << "Error importing model: " << importer.GetErrorString() << std::endl;
+                exit(1);
+            }
+            g_sink = g_sink + scene->mNumMeshes;
+        });
+    }
+}
+
+void benchmarkExport(const BenchOptions &options, const QString &modelPath) {
+    if (!QFileInfo::exists(modelPath)) {
+        std::cout << "Skipping the export, " << modelPath.toStdString() << " does not exist" << std::endl;
+        return;
+    }
+    Assimp::Importer importer;
+    setModelImportProperties(importer);
+    const aiScene *scene = importer.ReadFile(modelPath.toStdString(), MODEL_IMPORT_FLAGS);
+    if (!scene) {
+        std::cerr << "Error importing model: " << importer.GetErrorString() << std::endl;
+        exit(1);
+    }
+
+    // binary FBX into memory, the arrays written as they are (as before) against deflated on one thread and on
+    // every core. The size column is the size of the file
+    struct ExportVariant {
+        QString name;
+        int level;
+        int threads;
+    };
+    const int cores = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    std::vector<ExportVariant> variants{{QLatin1String("export/fbx/uncompressed"), 0, 1}};
+    for (const int level: {1, 6}) {
+        variants.push_back({QStringLiteral("export/fbx/level%1/threads1").arg(level), level, 1});
+        if (cores > 1)
+            variants.push_back({QStringLiteral("export/fbx/level%1/threads%2").arg(level).arg(cores), level, cores});
+    }
+    for (const auto &variant: variants) {
+        if (!options.filter.isEmpty() && !variant.name.contains(options.filter))
+            continue;
+        Assimp::ExportProperties properties;
+        properties.SetPropertyInteger(AI_CONFIG_EXPORT_FBX_COMPRESSION_LEVEL, variant.level);
+        properties.SetPropertyInteger(AI_CONFIG_EXPORT_FBX_COMPRESSION_THREADS, variant.threads);
+        const auto exportScene = [&] {
+            Assimp::Exporter exporter;
+            const aiExportDataBlob *blob = exporter.ExportToBlob(scene, "fbx", 0, &properties);
+            if (!blob) {
+                std::cerr << "Error exporting model: " << exporter.GetErrorString() << std::endl;
+                exit(1);
+            }
+            return blob->size;
+        };
+        const QString size = QString::number(exportScene() / 1e6, 'f', 1) + QLatin1String("MB");
+        run(options, variant.name, size, 0.0, [&] {
+            g_sink = g_sink + exportScene();
+        });
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String(
+        "Times picking, mesh preparation, close vertex lookups, texture encoding, per frame math, the model import "
+        "and its FBX export on the CPU"));
+    parser.addHelpOption();
+    BenchOptions options;
+    QCommandLineOption filterOption("filter", QLatin1String("Only run benchmarks whose name contains <text>"),
+                                    QLatin1String("text"));
+    parser.addOption(filterOption);
+    QCommandLineOption minTimeOption("min-time",
+                                     QStringLiteral("Repeat every benchmark for at least <ms> (default %1)")
+                                         .arg(options.minMillis), QLatin1String("ms"));
+    parser.addOption(minTimeOption);
+    QCommandLineOption maxTrianglesOption("max-triangles",
+                                          QStringLiteral("Largest synthetic mesh, meshes grow tenfold from 10k "
+                                                         "(default %1)").arg(options.maxTriangles),
+                                          QLatin1String("count"));
+    parser.addOption(maxTrianglesOption);
+    QCommandLineOption modelOption("model",
+                                   QLatin1String("Model to import and export (default ../resources/inner_ear.fbx)"),
+                                   QLatin1String("file"));
+    parser.addOption(modelOption);
+    parser.process(app);
+
+    options.filter = parser.value(filterOption);
+    if (parser.isSet(minTimeOption)) {
+        bool valid = false;
+        options.minMillis = parser.value(minTimeOption).toDouble(&valid);
+        if (!valid || options.minMillis < 0.0)
+            parser.showHelp(1);
+    }
+    if (parser.isSet(maxTrianglesOption)) {
+        bool valid = false;
+        options.maxTriangles = parser.value(maxTrianglesOption).toLongLong(&valid);
+        if (!valid || options.maxTriangles < 10000)
+            parser.showHelp(1);
+    }
+    const QString modelPath = parser.isSet(modelOption) ? parser.value(modelOption)
+                                                        : QStringLiteral("../resources/inner_ear.fbx");
+
+    std::cout << QString::asprintf("%-28s %10s %8s %14s %14s", "benchmark", "size", "calls", "ms per call",
+                                   "items per us").toStdString() << std::endl;
+    benchmarkMeshes(options);
+    benchmarkSpatialIndex(options);
+    benchmarkTextures(options);
+    benchmarkPerFrame(options);
+    benchmarkImport(options, modelPath);
+    benchmarkExport(options, modelPath);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Offline converter from the FBX (or anything assimp reads) to a Draco package the app loads with --model.
+
+#include <algorithm>
+#include <iostream>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <assimp/Importer.hpp>
+
+#include "DracoPackage.h"
+#include "ModelLoader.h"
+#include "assimp/scene.h"
+
+static int bitsOption(const QCommandLineParser &parser, const QCommandLineOption &option, const int fallback)
+{
+    if (!parser.isSet(option))
+        return fallback;
+    bool valid = false;
+    const int bits = parser.value(option).toInt(&valid);
+    if (!valid || bits < 1 || bits > 30) {
+        std::cerr << "Quantization bits must be between 1 and 30" << std::endl;
+        exit(1);
+    }
+    return bits;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String(
+        "Compresses the meshes of a model with Draco. Writes glTF (.glb) with KHR_draco_mesh_compression and the "
+        "embedded textures, or the first mesh alone when the output ends in .drc"));
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", QLatin1String("Model to convert, e.g. resources/inner_ear.fbx"));
+    parser.addPositionalArgument("output", QLatin1String("Package to write, .glb or .drc"));
+    DracoEncodeOptions options;
+    QCommandLineOption positionBitsOption("position-bits",
+                                          QStringLiteral("Quantization bits of positions (default %1)")
+                                              .arg(options.positionBits), QLatin1String("bits"));
+    parser.addOption(positionBitsOption);
+    QCommandLineOption normalBitsOption("normal-bits",
+                                        QStringLiteral("Quantization bits of normals (default %1)")
+                                            .arg(options.normalBits), QLatin1String("bits"));
+    parser.addOption(normalBitsOption);
+    QCommandLineOption texCoordBitsOption("texcoord-bits",
+                                          QStringLiteral("Quantization bits of texture coordinates (default %1)")
+                                              .arg(options.texCoordBits), QLatin1String("bits"));
+    parser.addOption(texCoordBitsOption);
+    QCommandLineOption speedOption("speed",
+                                   QStringLiteral("0 compresses best, 10 decodes fastest (default %1)")
+                                       .arg(options.speed), QLatin1String("speed"));
+    parser.addOption(speedOption);
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 2)
+        parser.showHelp(1);
+    const QString inputPath = arguments[0];
+    const QString outputPath = arguments[1];
+    options.positionBits = bitsOption(parser, positionBitsOption, options.positionBits);
+    options.normalBits = bitsOption(parser, normalBitsOption, options.normalBits);
+    options.texCoordBits = bitsOption(parser, texCoordBitsOption, options.texCoordBits);
+    if (parser.isSet(speedOption)) {
+        bool valid = false;
+        options.speed = parser.value(speedOption).toInt(&valid);
+        if (!valid || options.speed < 0 || options.speed > 10) {
+            std::cerr << "Speed must be between 0 and 10" << std::endl;
+            return 1;
+        }
+    }
+
+    // imported exactly as the app imports it, so the package holds the same triangles
+    QElapsedTimer timer;
+    timer.start();
+    Assimp::Importer importer;
+    setModelImportProperties(importer);
+    const aiScene *scene = importer.ReadFile(inputPath.toStdString(), MODEL_IMPORT_FLAGS);
+    if (!scene) {
+        std::cerr << "Error importing model: " << importer.GetErrorString() << std::endl;
+        return 1;
+    }
+    const double importMillis = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    const bool standalone = QFileInfo(outputPath).suffix().toLower() == QLatin1String("drc");
+    if (standalone && scene->mNumMeshes != 1)
+        std::cout << "Only the first of " << scene->mNumMeshes << " meshes goes into the .drc" << std::endl;
+    const QByteArray package = standalone ? DracoPackage::encodeDrc(*scene, options)
+                                          : DracoPackage::encodeGlb(*scene, options);
+    if (package.isEmpty()) {
+        std::cerr << "Error encoding " << inputPath.toStdString() << std::endl;
+        return 1;
+    }
+    const double encodeMillis = timer.nsecsElapsed() / 1e6;
+
+    QSaveFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(package) != package.size() || !file.commit()) {
+        std::cerr << "Error writing " << outputPath.toStdString() << std::endl;
+        return 1;
+    }
+
+    // the app's own load path for the package, against assimp for the input
+    DracoPackage decoded;
+    if (!decoded.open(outputPath)) {
+        std::cerr << "Error decoding the package just written" << std::endl;
+        return 1;
+    }
+
+    const qint64 inputSize = QFileInfo(inputPath).size();
+    std::cout << inputPath.toStdString() << ": " << inputSize << " bytes, imported in " << importMillis << " ms"
+              << std::endl;
+    std::cout << outputPath.toStdString() << ": " << package.size() << " bytes ("
+              << 100.0 * package.size() / std::max<qint64>(inputSize, 1) << "% of the input), encoded in "
+              << encodeMillis << " ms, meshes decoded in " << decoded.decodeMillis() << " ms" << std::endl;
+    return 0;
+}
@@ -3,18 +3,25 @@
 
 #include "inner_ear_vis.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <QCoreApplication>
+#include <QFont>
+#include <QImage>
+#include <QKeyEvent>
 #include <QPlatformSurfaceEvent>
 #include <QPainter>
 #include <QFile>
+#include <QtMath>
 #include <rhi/qshader.h>
-#include <assimp/Importer.hpp>
 
-#include "assimp/postprocess.h"
 #include "assimp/scene.h"
-#define STB_IMAGE_IMPLEMENTATION
-#include "vendor/stb_image.h"
 #include "optional"
+#include "Profiler.h"
 #include "util.h"
 #include "vendor/easing/easing.h"
 
@@ -78,9 +85,14 @@ void RhiWindow::exposeEvent(QExposeEvent *) {
 bool RhiWindow::event(QEvent *e) {
     switch (e->type()) {
         case QEvent::UpdateRequest:
+            m_renderScheduled = false;
             render();
             break;
 
+        case QEvent::Resize:
+            scheduleRender();
+            break;
+
         case QEvent::PlatformSurface:
             if (static_cast<QPlatformSurfaceEvent *>(e)->surfaceEventType() ==
                 QPlatformSurfaceEvent::SurfaceAboutToBeDestroyed)
@@ -99,6 +111,9 @@ bool RhiWindow::event(QEvent *e) {
         case QEvent::Wheel:
             handleWheel(static_cast<QWheelEvent *>(e));
             break;
+        case QEvent::KeyPress:
+            handleKeyPress(static_cast<QKeyEvent *>(e));
+            break;
         default:
             break;
     }
@@ -107,10 +122,13 @@ bool RhiWindow::event(QEvent *e) {
 }
 
 
-void RhiWindow::init() {
+void RhiWindow::createRhi() {
+    // GPU frame times for the profiler, see recordGpuTime
+    const QRhi::Flags flags = QRhi::EnableTimestamps;
+
     if (m_graphicsApi == QRhi::Null) {
         QRhiNullInitParams params;
-        m_rhi.reset(QRhi::create(QRhi::Null, &params));
+        m_rhi.reset(QRhi::create(QRhi::Null, &params, flags));
     }
 
 #if QT_CONFIG(opengl)
@@ -118,8 +136,9 @@ void RhiWindow::init() {
         m_fallbackSurface.reset(QRhiGles2InitParams::newFallbackSurface());
         QRhiGles2InitParams params;
         params.fallbackSurface = m_fallbackSurface.get();
-        params.window = this;
-        m_rhi.reset(QRhi::create(QRhi::OpenGLES2, &params));
+        // offscreen rendering makes the context current on the fallback surface
+        params.window = m_offscreen ? nullptr : this;
+        m_rhi.reset(QRhi::create(QRhi::OpenGLES2, &params, flags));
     }
 #endif
 
@@ -127,23 +146,27 @@ void RhiWindow::init() {
     if (m_graphicsApi == QRhi::D3D11) {
         QRhiD3D11InitParams params;
         params.enableDebugLayer = true;
-        m_rhi.reset(QRhi::create(QRhi::D3D11, &params));
+        m_rhi.reset(QRhi::create(QRhi::D3D11, &params, flags));
     } else if (m_graphicsApi == QRhi::D3D12) {
         QRhiD3D12InitParams params;
         params.enableDebugLayer = true;
-        m_rhi.reset(QRhi::create(QRhi::D3D12, &params));
+        m_rhi.reset(QRhi::create(QRhi::D3D12, &params, flags));
     }
 #endif
 
 #if !QT_NO_METAL
     if (m_graphicsApi == QRhi::Metal) {
         QRhiMetalInitParams params;
-        m_rhi.reset(QRhi::create(QRhi::Metal, &params));
+        m_rhi.reset(QRhi::create(QRhi::Metal, &params, flags));
     }
 #endif
 
     if (!m_rhi)
         qFatal("Failed to create RHI backend");
+}
+
+void RhiWindow::init() {
+    createRhi();
 
     m_sc.reset(m_rhi->newSwapChain());
     m_ds.reset(m_rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil,
@@ -158,10 +181,78 @@ void RhiWindow::init() {
     customInit();
 }
 
+bool RhiWindow::initOffscreen(const QSize pixelSize) {
+    m_offscreen = true;
+    createRhi();
+
+    m_offscreenTexture.reset(m_rhi->newTexture(QRhiTexture::RGBA8, pixelSize, 1, QRhiTexture::RenderTarget));
+    if (!m_offscreenTexture->create())
+        return false;
+
+    m_ds.reset(m_rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, pixelSize));
+    if (!m_ds->create())
+        return false;
+
+    QRhiTextureRenderTargetDescription rtDesc({m_offscreenTexture.get()});
+    rtDesc.setDepthStencilBuffer(m_ds.get());
+    m_offscreenRt.reset(m_rhi->newTextureRenderTarget(rtDesc));
+    m_rp.reset(m_offscreenRt->newCompatibleRenderPassDescriptor());
+    m_offscreenRt->setRenderPassDescriptor(m_rp.get());
+    if (!m_offscreenRt->create())
+        return false;
+
+    customInit();
+    updateProjection(pixelSize);
+    m_initialized = true;
+    return true;
+}
+
+bool RhiWindow::renderOffscreenFrame() {
+    const ProfileScope scope("render");
+    {
+        const ProfileScope beginScope("beginFrame");
+        if (m_rhi->beginOffscreenFrame(&m_offscreenCb) != QRhi::FrameOpSuccess)
+            return false;
+    }
+    recordGpuTime();
+
+    timedCustomRender();
+    {
+        const ProfileScope endScope("endFrame");
+        m_rhi->endOffscreenFrame();
+    }
+    m_lastFrameSubmitNanos = Profiler::instance().nowNanos();
+    m_offscreenCb = nullptr;
+    return true;
+}
+
+void RhiWindow::recordGpuTime() {
+    // reported for an earlier frame, zero when the backend cannot measure it
+    const double gpuSeconds = currentCommandBuffer()->lastCompletedGpuTime();
+    if (gpuSeconds > 0.0) {
+        Profiler::instance().addGpuFrame(m_lastFrameSubmitNanos, gpuSeconds);
+        m_lastGpuMillis = gpuSeconds * 1e3;
+    }
+}
+
+QRhiCommandBuffer *RhiWindow::currentCommandBuffer() const {
+    return m_offscreen ? m_offscreenCb : m_sc->currentFrameCommandBuffer();
+}
+
+QRhiRenderTarget *RhiWindow::currentRenderTarget() const {
+    return m_offscreen ? static_cast<QRhiRenderTarget *>(m_offscreenRt.get()) : m_sc->currentFrameRenderTarget();
+}
+
+QSize RhiWindow::currentPixelSize() const {
+    return m_offscreen ? m_offscreenRt->pixelSize() : m_sc->currentPixelSize();
+}
+
 void RhiWindow::resizeSwapChain() {
     m_hasSwapChain = m_sc->createOrResize();
+    updateProjection(m_sc->currentPixelSize());
+}
 
-    const QSize outputSize = m_sc->currentPixelSize();
+void RhiWindow::updateProjection(const QSize outputSize) {
     QMatrix4x4 projection;
     projection.perspective(45.0f, static_cast<float>(outputSize.width()) / outputSize.height(), 0.1f, 1000.0f);
     m_projection = projection;
@@ -178,6 +269,8 @@ void RhiWindow::render() {
     if (!m_hasSwapChain || m_notExposed)
         return;
 
+    const ProfileScope scope("render");
+
     if (m_sc->currentPixelSize() != m_sc->surfacePixelSize() || m_newlyExposed) {
         resizeSwapChain();
         if (!m_hasSwapChain)
@@ -185,24 +278,68 @@ void RhiWindow::render() {
         m_newlyExposed = false;
     }
 
-    QRhi::FrameOpResult result = m_rhi->beginFrame(m_sc.get());
-    if (result == QRhi::FrameOpSwapChainOutOfDate) {
-        resizeSwapChain();
-        if (!m_hasSwapChain)
-            return;
+    QRhi::FrameOpResult result;
+    {
+        const ProfileScope beginScope("beginFrame");
         result = m_rhi->beginFrame(m_sc.get());
+        if (result == QRhi::FrameOpSwapChainOutOfDate) {
+            resizeSwapChain();
+            if (!m_hasSwapChain)
+                return;
+            result = m_rhi->beginFrame(m_sc.get());
+        }
     }
     if (result != QRhi::FrameOpSuccess) {
         qWarning("beginFrame failed with %d, will retry", result);
-        requestUpdate();
+        scheduleRender();
         return;
     }
+    recordGpuTime();
 
-    customRender();
-    m_rhi->endFrame(m_sc.get());
+    if (m_idle) {
+        // whatever time passed while idle must not advance animations
+        m_lastElapsedMillis = m_timer.elapsed();
+        m_idle = false;
+    }
+
+    timedCustomRender();
+    {
+        const ProfileScope endScope("endFrame");
+        m_rhi->endFrame(m_sc.get());
+    }
+    m_lastFrameSubmitNanos = Profiler::instance().nowNanos();
+
+    if (m_continuousRendering || isAnimating()) {
+        scheduleRender();
+    } else {
+        m_idle = true;
+    }
+}
+
+void RhiWindow::scheduleRender() {
+    // offscreen frames are driven by the caller
+    if (m_offscreen || m_renderScheduled) {
+        return;
+    }
+    m_renderScheduled = true;
     requestUpdate();
 }
 
+void RhiWindow::setContinuousRendering(const bool continuous) {
+    m_continuousRendering = continuous;
+    if (continuous) {
+        scheduleRender();
+    }
+}
+
+void RhiWindow::timedCustomRender() {
+    const ProfileScope scope("customRender");
+    QElapsedTimer customRenderTimer;
+    customRenderTimer.start();
+    customRender();
+    m_lastCustomRenderNanos = customRenderTimer.nsecsElapsed();
+}
+
 static QShader getShader(const QString &name) {
     QFile f(name);
     if (f.open(QIODevice::ReadOnly))
@@ -211,6 +348,33 @@ static QShader getShader(const QString &name) {
     return QShader();
 }
 
+static constexpr PipelineKey COLOR_PIPELINE{ShaderProgram::Color, BlendMode::PremultipliedAlpha,
+                                            QRhiGraphicsPipeline::Triangles};
+static constexpr PipelineKey RAY_PIPELINE{ShaderProgram::Ray, BlendMode::PremultipliedAlpha,
+                                          QRhiGraphicsPipeline::LineStrip};
+static constexpr PipelineKey OVERLAY_PIPELINE{ShaderProgram::Overlay, BlendMode::PremultipliedAlpha,
+                                              QRhiGraphicsPipeline::Triangles, DepthMode::Disabled};
+// the color attachments of the translucency pass
+static constexpr quint32 OPAQUE_ATTACHMENT = 1u << 0;
+static constexpr quint32 ACCUMULATION_ATTACHMENT = 1u << 1;
+static constexpr quint32 TRANSMITTANCE_ATTACHMENT = 1u << 2;
+// the translucency pass: opaque parts and rays as in the main pass, then the faded parts summed up in front of them
+static constexpr PipelineKey OFFSCREEN_COLOR_PIPELINE{ShaderProgram::Color, BlendMode::PremultipliedAlpha,
+                                                      QRhiGraphicsPipeline::Triangles, DepthMode::TestAndWrite,
+                                                      RenderPass::Translucency, OPAQUE_ATTACHMENT};
+static constexpr PipelineKey OFFSCREEN_RAY_PIPELINE{ShaderProgram::Ray, BlendMode::PremultipliedAlpha,
+                                                    QRhiGraphicsPipeline::LineStrip, DepthMode::TestAndWrite,
+                                                    RenderPass::Translucency, OPAQUE_ATTACHMENT};
+static constexpr PipelineKey TRANSLUCENT_PIPELINE{ShaderProgram::ColorTranslucent, BlendMode::Additive,
+                                                  QRhiGraphicsPipeline::Triangles, DepthMode::TestOnly,
+                                                  RenderPass::Translucency,
+                                                  ACCUMULATION_ATTACHMENT | TRANSMITTANCE_ATTACHMENT};
+static constexpr PipelineKey COMPOSITE_PIPELINE{ShaderProgram::TranslucencyComposite, BlendMode::Opaque,
+                                                QRhiGraphicsPipeline::Triangles, DepthMode::Disabled};
+
+// of the parts around a selection
+static constexpr float FADED_OPACITY = 0.25f;
+
 
 AppWindow::AppWindow(QRhi::Implementation graphicsApi)
     : RhiWindow(graphicsApi) {
@@ -219,142 +383,59 @@ AppWindow::AppWindow(QRhi::Implementation graphicsApi)
 void AppWindow::customInit() {
     m_timer.start();
 
-    const QSize outputSize = m_sc->currentPixelSize();
+    const QSize outputSize = currentPixelSize();
     auto projection = QMatrix4x4();
     projection.perspective(45.0f, outputSize.width() / (float) outputSize.height(), 0.01f, 1000.0f);
     m_projection = projection;
 
-    auto modelRotation = QMatrix4x4();
-    modelRotation.rotate(m_rotationAngles.y(), -1, 0, 0);
-    modelRotation.rotate(m_rotationAngles.x(), 0, 1, 0);
-    m_modelRotation = modelRotation;
+    updateModelRotation();
 
     m_initialUpdates = m_rhi->nextResourceUpdateBatch();
 
-    Assimp::Importer importer;
-    const auto scene = importer.ReadFile(
-        "../resources/inner_ear.fbx",
-        aiProcess_Triangulate
-    );
-
-    if (!scene) {
-        std::cerr << "Error importing model: " << importer.GetErrorString() << std::endl;
-        exit(1);
-    }
-
-    std::unordered_map<unsigned int, QRhiTexture *> materialIndexToTexture;
-
-    for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
-        const aiMaterial *material = scene->mMaterials[i];
-
-        if (material->GetTextureCount(aiTextureType_DIFFUSE) <= 0) {
-            std::cout << "Texture count 0 or less. Skipping..." << std::endl;
-            continue;
-        }
-
-        aiString str;
-        if (material->GetTexture(aiTextureType_DIFFUSE, 0, &str) != AI_SUCCESS) {
-            std::cerr << "Error loading texture: " << str.C_Str() << std::endl;
-            exit(1);
-        }
-
-        const aiTexture *a_texture = scene->GetEmbeddedTexture(str.C_Str());
-
-        if (a_texture == nullptr) {
-            std::cerr << "Error loading texture: " << str.C_Str() << std::endl;
-            exit(1);
-        }
-
-        std::cout << "Texture path: " << str.C_Str() << std::endl;
-
-        int width, height, channels;
-        unsigned char *data = stbi_load_from_memory(
-            reinterpret_cast<unsigned char *>(a_texture->pcData),
-            a_texture->mWidth,
-            &width,
-            &height,
-            &channels,
-            0
-        );
-
-        if (!data) {
-            std::cerr << "Error loading texture: " << str.C_Str() << ". Exiting..." << std::endl;
-            exit(1);
-        }
-
-        const auto texture = m_rhi->newTexture(QRhiTexture::RGBA8, QSize(width, height));
-        texture->create();
-
-        const auto rgbaData = new uchar[width * height * 4];
-
-        for (int x = 0; x < width * height; ++x) {
-            rgbaData[4 * x + 0] = data[3 * x + 0]; // R
-            rgbaData[4 * x + 1] = data[3 * x + 1]; // G
-            rgbaData[4 * x + 2] = data[3 * x + 2]; // B
-            rgbaData[4 * x + 3] = 255; // A (fully opaque)
-        }
-
-        QImage image(rgbaData, width, height, QImage::Format_RGBA8888);
-        m_initialUpdates->uploadTexture(texture, image);
-        materialIndexToTexture[i] = texture;
-        stbi_image_free(data);
+    // every material texture becomes a layer of one texture array, see applyModelLayout. Backends without them are
+    // below the GLSL the shaders are built for anyway, the model is not loaded there
+    if (!m_rhi->isFeatureSupported(QRhi::TextureArrays)) {
+        failLoading(QStringLiteral("Texture arrays are not supported by the graphics backend"));
+    } else {
+        // Loads in the background, frames show the parts that are ready so far (see applyLoadProgress).
+        // textures come block-compressed where the backend can sample BC1, with their full mip chain either way
+        m_textureEncoding = m_rhi->isTextureFormatSupported(QRhiTexture::BC1, QRhiTexture::MipMapped)
+                                ? TextureEncoding::BC1
+                                : TextureEncoding::RGBA8;
+        m_modelLoader = std::make_unique<ModelLoader>(
+            m_modelPath, MODEL_IMPORT_FLAGS, m_meshCacheEnabled, m_mappedImportEnabled, m_textureEncoding);
     }
 
-    m_sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+    // trilinear, zoomed out parts sample the smaller levels instead of aliasing
+    m_sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Linear,
                                       QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
     m_sampler->create();
 
-    // uniform buffers
-    constexpr quint32 UBUF_SIZE = 64 + 64 + 4;
-    m_normalUbuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, UBUF_SIZE));
-    m_normalUbuf->create();
-    m_greyedOutUbuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, UBUF_SIZE));
-    m_greyedOutUbuf->create();
+    // uniform buffers: matrices once per frame, rendering mode, opacity and position dequantization per entity at a
+    // dynamic offset
+    constexpr quint32 FRAME_UBUF_SIZE = 64 + 64;
+    m_frameUbuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, FRAME_UBUF_SIZE));
+    m_frameUbuf->create();
+
+    // one InstanceData per specimen, rewritten every frame along with their rendering modes
+    m_instanceData.resize(m_instanceCount);
+    m_instanceBuffer.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer,
+                                            m_instanceCount * sizeof(InstanceData)));
+    m_instanceBuffer->create();
+    updateInstanceLayout();
 
     m_rayUniformBuffer.reset(
         m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, 64));
     m_rayUniformBuffer->create();
 
-    // entity initialization
-    m_entities.reserve(8);
-    for (int j = 0; j < scene->mNumMeshes; ++j) {
-        const auto mesh = scene->mMeshes[j];
+    static constexpr QRhiShaderResourceBinding::StageFlags visibility =
+            QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage;
 
-        assert(mesh->HasPositions());
-        assert(mesh->HasNormals());
-        assert(mesh->HasTextureCoords(0));
+    m_pipelineCache = std::make_unique<PipelineCache>(*m_rhi, m_rp.get());
 
-        m_entities.emplace_back(*mesh, materialIndexToTexture[mesh->mMaterialIndex], m_sampler.get(), *m_rhi,
-                                m_initialUpdates, m_normalUbuf.get(), m_greyedOutUbuf.get());
-    }
-
-    // entity rendering setup
-    m_colorPipeline.reset(m_rhi->newGraphicsPipeline());
-    m_colorPipeline->setDepthTest(true);
-    m_colorPipeline->setDepthWrite(true);
-    QRhiGraphicsPipeline::TargetBlend premulAlphaBlend;
-    premulAlphaBlend.enable = true;
-    m_colorPipeline->setTargetBlends({premulAlphaBlend});
-    m_colorPipeline->setShaderStages({
-        {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/color.vert.qsb"))},
-        {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/color.frag.qsb"))}
-    });
-    QRhiVertexInputLayout inputLayout;
-    constexpr auto positionSize = 3;
-    constexpr auto normalSize = 3;
-    constexpr auto textureCoords = 2;
-    constexpr auto stride = positionSize + normalSize + textureCoords;
-    inputLayout.setBindings({
-        {stride * sizeof(float)}
-    });
-    inputLayout.setAttributes({
-        {0, 0, QRhiVertexInputAttribute::Float3, 0},
-        {0, 1, QRhiVertexInputAttribute::Float3, 3 * sizeof(float)},
-        {0, 2, QRhiVertexInputAttribute::Float2, 6 * sizeof(float)},
-    });
-    m_colorPipeline->setVertexInputLayout(inputLayout);
-    m_colorPipeline->setRenderPassDescriptor(m_rp.get());
-    m_colorPipeline->create();
+    // picking starts out empty, the scene is rebuilt whenever the loader hands over more entities
+    m_pickingScene = std::make_shared<const PickingScene>(std::vector<std::shared_ptr<const PickingGeometry>>{});
+    m_hoverPicking = std::make_unique<PickingService>(m_pickingScene);
 
     // ray rendering setup
     constexpr float rayInitialData[] = {
@@ -369,14 +450,6 @@ void AppWindow::customInit() {
     m_rayVertexBuffer->create();
     m_initialUpdates->updateDynamicBuffer(m_rayVertexBuffer.get(), 0, 2 * 3 * sizeof(float), rayInitialData);
 
-    m_rayPipeline.reset(m_rhi->newGraphicsPipeline());
-    m_rayPipeline->setDepthTest(true);
-    m_rayPipeline->setDepthWrite(true);
-    m_rayPipeline->setTargetBlends({premulAlphaBlend});
-    m_rayPipeline->setShaderStages({
-        {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/ray.vert.qsb"))},
-        {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/ray.frag.qsb"))}
-    });
     QRhiVertexInputLayout rayInputLayout;
     rayInputLayout.setBindings({
         {3 * sizeof(float)}
@@ -384,24 +457,328 @@ void AppWindow::customInit() {
     rayInputLayout.setAttributes({
         {0, 0, QRhiVertexInputAttribute::Float3, 0},
     });
-    m_rayPipeline->setVertexInputLayout(rayInputLayout);
-    m_rayPipeline->setRenderPassDescriptor(m_rp.get());
-    m_rayPipeline->setTopology(QRhiGraphicsPipeline::LineStrip);
     m_raySrb.reset(m_rhi->newShaderResourceBindings());
-    static constexpr QRhiShaderResourceBinding::StageFlags visibility =
-            QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage;
-
     m_raySrb->setBindings({
         QRhiShaderResourceBinding::uniformBuffer(0, visibility, m_rayUniformBuffer.get()),
     });
     m_raySrb->create();
-    m_rayPipeline->setShaderResourceBindings(m_raySrb.get());
-    m_rayPipeline->create();
+    m_pipelineCache->registerProgram(ShaderProgram::Ray, {
+        {
+            {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/ray.vert.qsb"))},
+            {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/ray.frag.qsb"))}
+        },
+        rayInputLayout,
+        m_raySrb.get()
+    });
+
+    // stats overlay: a full screen triangle sampling the text texture, resized along with the window
+    m_overlayTexture.reset(m_rhi->newTexture(QRhiTexture::RGBA8, QSize(1, 1)));
+    m_overlayTexture->create();
+    m_overlaySampler.reset(m_rhi->newSampler(QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None,
+                                             QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+    m_overlaySampler->create();
+    m_overlaySrb.reset(m_rhi->newShaderResourceBindings());
+    m_overlaySrb->setBindings({
+        QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage,
+                                                  m_overlayTexture.get(), m_overlaySampler.get())
+    });
+    m_overlaySrb->create();
+    m_pipelineCache->registerProgram(ShaderProgram::Overlay, {
+        {
+            {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/quad.vert.qsb"))},
+            {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/quad.frag.qsb"))}
+        },
+        QRhiVertexInputLayout(),
+        m_overlaySrb.get()
+    });
+
+    // translucency: targets at the size of the frame, resized along with it before they are drawn into
+    m_translucencySupported = m_rhi->isTextureFormatSupported(QRhiTexture::RGBA16F) &&
+                              m_rhi->isTextureFormatSupported(QRhiTexture::R16F) &&
+                              updateTranslucencyTargets(currentPixelSize());
+    if (m_translucencySupported) {
+        m_pipelineCache->registerProgram(ShaderProgram::TranslucencyComposite, {
+            {
+                {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/quad.vert.qsb"))},
+                {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/translucency_composite.frag.qsb"))}
+            },
+            QRhiVertexInputLayout(),
+            m_compositeSrb.get()
+        });
+        m_translucencySupported = m_pipelineCache->pipeline(COMPOSITE_PIPELINE) &&
+                                  m_pipelineCache->pipeline(OFFSCREEN_RAY_PIPELINE);
+    }
+    if (!m_translucencySupported) {
+        std::cout << "No translucency pass, parts around a selection stay opaque" << std::endl;
+    }
+
+    // the color pipeline follows once the model layout is known, in applyModelLayout
+    if (!m_pipelineCache->pipeline(RAY_PIPELINE) || !m_pipelineCache->pipeline(OVERLAY_PIPELINE)) {
+        failLoading(QStringLiteral("Error creating the ray and overlay pipelines"));
+    }
+}
+
+bool AppWindow::updateTranslucencyTargets(const QSize outputSize) {
+    // at least a pixel, the swapchain may not have a size yet
+    const QSize pixelSize = outputSize.expandedTo(QSize(1, 1));
+    if (!m_translucencyRt) {
+        m_opaqueTexture.reset(m_rhi->newTexture(QRhiTexture::RGBA8, pixelSize, 1, QRhiTexture::RenderTarget));
+        m_accumulationTexture.reset(m_rhi->newTexture(QRhiTexture::RGBA16F, pixelSize, 1, QRhiTexture::RenderTarget));
+        m_transmittanceTexture.reset(m_rhi->newTexture(QRhiTexture::R16F, pixelSize, 1, QRhiTexture::RenderTarget));
+        m_translucencyDepth.reset(m_rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, pixelSize));
+
+        QRhiTextureRenderTargetDescription description;
+        description.setColorAttachments({
+            QRhiColorAttachment(m_opaqueTexture.get()),
+            QRhiColorAttachment(m_accumulationTexture.get()),
+            QRhiColorAttachment(m_transmittanceTexture.get())
+        });
+        description.setDepthStencilBuffer(m_translucencyDepth.get());
+        m_translucencyRt.reset(m_rhi->newTextureRenderTarget(description));
+        m_translucencyRp.reset(m_translucencyRt->newCompatibleRenderPassDescriptor());
+        m_translucencyRt->setRenderPassDescriptor(m_translucencyRp.get());
+        m_pipelineCache->registerRenderPass(RenderPass::Translucency, m_translucencyRp.get(), 3);
+
+        // read with texelFetch, one texel per fragment
+        m_translucencySampler.reset(m_rhi->newSampler(QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None,
+                                                      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+        m_translucencySampler->create();
+        m_compositeSrb.reset(m_rhi->newShaderResourceBindings());
+        m_compositeSrb->setBindings({
+            QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage,
+                                                      m_opaqueTexture.get(), m_translucencySampler.get()),
+            QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
+                                                      m_accumulationTexture.get(), m_translucencySampler.get()),
+            QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage,
+                                                      m_transmittanceTexture.get(), m_translucencySampler.get())
+        });
+    } else if (m_opaqueTexture->pixelSize() == pixelSize) {
+        return true;
+    }
+
+    m_opaqueTexture->setPixelSize(pixelSize);
+    m_accumulationTexture->setPixelSize(pixelSize);
+    m_transmittanceTexture->setPixelSize(pixelSize);
+    m_translucencyDepth->setPixelSize(pixelSize);
+    if (!m_opaqueTexture->create() || !m_accumulationTexture->create() || !m_transmittanceTexture->create() || !m_translucencyDepth->create() ||
+        !m_translucencyRt->create()) {
+        std::cerr << "Error creating the translucency targets" << std::endl;
+        return false;
+    }
+    m_compositeSrb->create();
+    return true;
+}
+
+void AppWindow::disableTranslucency() {
+    std::cout << "Parts around a selection stay opaque from now on" << std::endl;
+    m_translucencySupported = false;
+    for (auto &entity: m_entities) {
+        entity.m_opacity = 1.0f;
+    }
+    // a running tween keeps them there
+    fadeEntities(m_selectedEntity);
+}
+
+// Sizes the shared geometry, the texture array and the entity uniforms for the whole model, before any of it arrives.
+void AppWindow::applyModelLayout(const ModelLayout &layout) {
+    m_sceneGeometry.allocate(*m_rhi, layout);
+
+    // layers share a size, the loader scales smaller textures up before building their mip chains
+    QSize layerSize(1, 1);
+    for (const auto &texture: layout.textures) {
+        layerSize = layerSize.expandedTo(QSize(texture.width, texture.height));
+    }
+    const int layerCount = std::max<int>(static_cast<int>(layout.textures.size()), 1);
+    m_textureArray.reset(m_rhi->newTextureArray(
+        m_textureEncoding == TextureEncoding::BC1 ? QRhiTexture::BC1 : QRhiTexture::RGBA8, layerCount, layerSize, 1,
+        QRhiTexture::MipMapped));
+    m_textureArray->create();
+    m_textureArrayBytes = TextureCache::mipChainSize(layerSize, m_textureEncoding) * layerCount;
+    m_materialIndexToLayer.clear();
+    for (size_t layer = 0; layer < layout.textures.size(); ++layer) {
+        m_materialIndexToLayer[layout.textures[layer].materialIndex] = static_cast<int>(layer);
+    }
+    m_uploadedLayers.assign(layout.textures.size(), false);
+
+    m_entities.reserve(layout.meshes.size());
+    m_entityUniformStride = m_rhi->ubufAligned(sizeof(EntityUniforms));
+    m_entityUniforms.resize(static_cast<qsizetype>(m_entityUniformStride * std::max<size_t>(layout.meshes.size(), 1)));
+    m_entityUbuf.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer,
+                                        static_cast<quint32>(m_entityUniforms.size())));
+    m_entityUbuf->create();
+
+    // the only bindings the model is drawn with, draws differ in the entity uniform offset
+    m_sceneSrb.reset(m_rhi->newShaderResourceBindings());
+    m_sceneSrb->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, m_frameUbuf.get()),
+        // the vertex stage dequantizes the positions with it
+        QRhiShaderResourceBinding::uniformBufferWithDynamicOffset(
+            1, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage,
+            m_entityUbuf.get(), sizeof(EntityUniforms)),
+        QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage,
+                                                  m_textureArray.get(), m_sampler.get())
+    });
+    m_sceneSrb->create();
+
+    // entity rendering setup
+    QRhiVertexInputLayout inputLayout;
+    inputLayout.setBindings({
+        {sizeof(QuantizedVertex)},
+        // advances once per specimen, a single draw per entity covers all of them
+        {sizeof(InstanceData), QRhiVertexInputBinding::PerInstance}
+    });
+    inputLayout.setAttributes({
+        // a QuantizedVertex as four 32 bit words, unpacked in color.vert
+        {0, 0, QRhiVertexInputAttribute::UInt4, 0},
+        // the transform takes one location per column
+        {1, 3, QRhiVertexInputAttribute::Float4, 0},
+        {1, 4, QRhiVertexInputAttribute::Float4, 4 * sizeof(float)},
+        {1, 5, QRhiVertexInputAttribute::Float4, 8 * sizeof(float)},
+        {1, 6, QRhiVertexInputAttribute::Float4, 12 * sizeof(float)},
+        {1, 7, QRhiVertexInputAttribute::SInt, offsetof(InstanceData, renderingMode)},
+        {1, 8, QRhiVertexInputAttribute::SInt, offsetof(InstanceData, hovered)},
+    });
+    m_pipelineCache->registerProgram(ShaderProgram::Color, {
+        {
+            {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/color.vert.qsb"))},
+            {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/color.frag.qsb"))}
+        },
+        inputLayout,
+        m_sceneSrb.get()
+    });
+
+    // the same geometry and bindings, written into the translucency targets
+    if (m_translucencySupported) {
+        m_pipelineCache->registerProgram(ShaderProgram::ColorTranslucent, {
+            {
+                {QRhiShaderStage::Vertex, getShader(QLatin1String(":/shaders/color.vert.qsb"))},
+                {QRhiShaderStage::Fragment, getShader(QLatin1String(":/shaders/color_translucent.frag.qsb"))}
+            },
+            inputLayout,
+            m_sceneSrb.get()
+        });
+    }
+
+    // every render state combination drawn later is built here, frames only switch between them
+    if (!m_pipelineCache->pipeline(COLOR_PIPELINE)) {
+        failLoading(QStringLiteral("Error creating the color pipeline"));
+        return;
+    }
+    if (m_translucencySupported &&
+        (!m_pipelineCache->pipeline(OFFSCREEN_COLOR_PIPELINE) || !m_pipelineCache->pipeline(TRANSLUCENT_PIPELINE))) {
+        disableTranslucency();
+    }
+}
+
+// Uploads whatever the loader finished since the last frame and turns finished meshes into entities.
+void AppWindow::applyLoadProgress(QRhiResourceUpdateBatch *resourceUpdates) {
+    if (m_modelLoaded || m_loadFailed) {
+        return;
+    }
+
+    const ProfileScope scope("loadProgress");
+    auto progress = m_modelLoader->takeProgress();
+    if (progress.failed) {
+        failLoading(progress.error);
+        return;
+    }
+    if (progress.layout.has_value()) {
+        applyModelLayout(progress.layout.value());
+        if (m_loadFailed) {
+            return;
+        }
+    }
+
+    for (const auto &[layer, texture]: progress.textures) {
+        // every level of the layer in one upload, the level data is copied into the batch
+        QList<QRhiTextureUploadEntry> levels;
+        for (size_t level = 0; level < texture.levels.size(); ++level) {
+            levels.append(QRhiTextureUploadEntry(
+                static_cast<int>(layer), static_cast<int>(level),
+                QRhiTextureSubresourceUploadDescription(texture.levels[level].data, texture.levels[level].size)));
+        }
+        QRhiTextureUploadDescription description;
+        description.setEntries(levels.cbegin(), levels.cend());
+        resourceUpdates->uploadTexture(m_textureArray.get(), description);
+        m_uploadedLayers[layer] = true;
+
+        // entities that arrived before their texture were drawn untextured so far
+        for (auto &entity: m_entities) {
+            const auto entityLayer = m_materialIndexToLayer.find(entity.m_materialIndex);
+            if (entityLayer != m_materialIndexToLayer.end() && entityLayer->second == static_cast<int>(layer)) {
+                entity.m_textureLayer = entityLayer->second;
+            }
+        }
+    }
+
+    for (const auto &[meshIndex, mesh]: progress.meshes) {
+        m_sceneGeometry.upload(resourceUpdates, meshIndex, mesh);
+        const auto layer = m_materialIndexToLayer.find(mesh.materialIndex);
+        const bool textured = layer != m_materialIndexToLayer.end() && m_uploadedLayers[layer->second];
+        m_entities.emplace_back(mesh, m_sceneGeometry.ranges()[meshIndex], textured ? layer->second : -1);
+    }
+
+    if (!progress.meshes.empty()) {
+        // top level acceleration structure for picking, over the bounds of the per entity hierarchies
+        std::vector<std::shared_ptr<const PickingGeometry>> pickingGeometry;
+        pickingGeometry.reserve(m_entities.size());
+        for (const auto &entity: m_entities) {
+            pickingGeometry.push_back(entity.m_picking);
+        }
+        m_pickingScene = std::make_shared<const PickingScene>(std::move(pickingGeometry));
+        m_hoverPicking->setScene(m_pickingScene);
+        updateMemoryTotals();
+        updateInstanceLayout();
+    }
+
+    if (progress.finished) {
+        m_modelLoaded = true;
+        m_fullyLoadedMillis = m_processTimer.nsecsElapsed() / 1e6;
+        std::cout << "Fully loaded after " << m_fullyLoadedMillis << " ms" << std::endl;
+
+        auto &profiler = Profiler::instance();
+        profiler.addCounter("gpu geometry MB", (m_memoryTotals.gpuVertexBytes + m_memoryTotals.gpuIndexBytes) / 1e6);
+        profiler.addCounter("gpu textures MB", m_textureArrayBytes / 1e6);
+        profiler.addCounter("cpu picking MB", m_memoryTotals.cpuPickingBytes / 1e6);
+    }
+}
+
+void AppWindow::failLoading(const QString &error) {
+    std::cerr << error.toStdString() << ". Exiting..." << std::endl;
+    m_loadFailed = true;
+    // the benchmark loop checks m_loadFailed
+    QCoreApplication::exit(1);
+}
+
+void AppWindow::updateMemoryTotals() {
+    const quint32 indexSize = m_sceneGeometry.indexFormat() == QRhiCommandBuffer::IndexUInt16 ? 2 : 4;
+    m_memoryTotals = {};
+    m_largestEntity = -1;
+    quint64 largestBytes = 0;
+    for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
+        const auto memory = m_entities[entityIndex].memory(indexSize);
+        m_memoryTotals.gpuVertexBytes += memory.gpuVertexBytes;
+        m_memoryTotals.gpuIndexBytes += memory.gpuIndexBytes;
+        m_memoryTotals.cpuPickingBytes += memory.cpuPickingBytes;
+        const quint64 bytes = memory.gpuVertexBytes + memory.gpuIndexBytes + memory.cpuPickingBytes;
+        if (bytes > largestBytes) {
+            largestBytes = bytes;
+            m_largestEntity = entityIndex;
+        }
+    }
 }
 
 void AppWindow::customRender() {
+    // on the way out, possibly without the pipelines to draw with (see failLoading)
+    if (m_loadFailed) {
+        QRhiCommandBuffer *cb = currentCommandBuffer();
+        cb->beginPass(currentRenderTarget(), Qt::black, {1.0f, 0});
+        cb->endPass();
+        return;
+    }
+
     const auto nowElapsed = m_timer.elapsed();
-    m_deltaTime = (nowElapsed - m_lastElapsedMillis) / 1000.f;
+    m_deltaTime = m_fixedDeltaTime > 0 ? m_fixedDeltaTime : (nowElapsed - m_lastElapsedMillis) / 1000.f;
     m_lastElapsedMillis = nowElapsed;
 
     if (m_selectionTween.playing) {
@@ -418,10 +795,31 @@ void AppWindow::customRender() {
         const auto tweenedCenter = lerp(m_selectionTween.startValueCenter, m_selectionTween.endValueCenter,
                                         tweenedRatio);
         m_camera.setLookAt(tweenedEye, tweenedCenter, QVector3D(0, 1, 0));
+        // parts that arrive during the tween are not faded
+        for (size_t i = 0; i < m_selectionTween.endOpacities.size(); ++i) {
+            m_entities[i].m_opacity = lerp(m_selectionTween.startOpacities[i], m_selectionTween.endOpacities[i],
+                                           tweenedRatio);
+        }
     }
 
+    // faded parts need the translucency targets at the size of the frame, without them they are drawn opaque
+    const bool anyFaded = std::any_of(m_entities.cbegin(), m_entities.cend(), [](const Entity &entity) {
+        return entity.m_opacity < 1.0f;
+    });
+    if (anyFaded && !updateTranslucencyTargets(currentPixelSize())) {
+        disableTranslucency();
+    }
+
+    applyHoverPick();
+
     QRhiResourceUpdateBatch *resourceUpdates = m_rhi->nextResourceUpdateBatch();
+    // pipelines built for newly arrived parts belong to loading, not to drawing the frame
+    applyLoadProgress(resourceUpdates);
+
+    const quint64 pipelineCreationsBefore = m_pipelineCache->pipelineCreations();
 
+    std::optional<ProfileScope> phase;
+    phase.emplace("resourceUpdates");
     if (m_initialUpdates) {
         resourceUpdates->merge(m_initialUpdates);
         m_initialUpdates->release();
@@ -438,46 +836,143 @@ void AppWindow::customRender() {
     }
     resourceUpdates->updateDynamicBuffer(m_rayUniformBuffer.get(), 0, 64, m_viewProjection.constData());
 
-    constexpr auto normalRenderingMode = RenderingMode::Normal;
-    constexpr auto greyedOutRenderingMode = RenderingMode::GreyedOut;
-    resourceUpdates->updateDynamicBuffer(m_normalUbuf.get(), 0, 64, m_modelRotation.constData());
-    resourceUpdates->updateDynamicBuffer(m_normalUbuf.get(), 64, 64, viewProjection.constData());
-    resourceUpdates->updateDynamicBuffer(m_normalUbuf.get(), 128, 4, &normalRenderingMode);
+    resourceUpdates->updateDynamicBuffer(m_frameUbuf.get(), 0, 64, m_modelRotation.constData());
+    resourceUpdates->updateDynamicBuffer(m_frameUbuf.get(), 64, 64, viewProjection.constData());
+
+    updateInstanceData(resourceUpdates);
+
+    // one block per entity, written in a single update
+    for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
+        const auto &entity = m_entities[entityIndex];
+        const auto &offset = entity.m_dequantization.offset;
+        const auto &scale = entity.m_dequantization.scale;
+        const EntityUniforms uniforms{
+            static_cast<qint32>(entity.m_renderingMode), entity.m_opacity, entity.m_textureLayer,
+            entityIndex == m_hoveredEntity ? 1 : 0,
+            {offset.x(), offset.y(), offset.z(), 0.0f},
+            {scale.x(), scale.y(), scale.z(), 0.0f}
+        };
+        std::memcpy(m_entityUniforms.data() + entityIndex * m_entityUniformStride, &uniforms, sizeof(uniforms));
+    }
+    if (m_entityUbuf) {
+        resourceUpdates->updateDynamicBuffer(m_entityUbuf.get(), 0, static_cast<quint32>(m_entityUniforms.size()),
+                                             m_entityUniforms.constData());
+    }
 
-    resourceUpdates->updateDynamicBuffer(m_greyedOutUbuf.get(), 0, 64, m_modelRotation.constData());
-    resourceUpdates->updateDynamicBuffer(m_greyedOutUbuf.get(), 64, 64, viewProjection.constData());
-    resourceUpdates->updateDynamicBuffer(m_greyedOutUbuf.get(), 128, 4, &greyedOutRenderingMode);
+    if (m_statsOverlayVisible) {
+        updateStatsOverlay(resourceUpdates);
+    }
 
-    QRhiCommandBuffer *cb = m_sc->currentFrameCommandBuffer();
-    const QSize outputSizeInPixels = m_sc->currentPixelSize();
+    QRhiCommandBuffer *cb = currentCommandBuffer();
+    const QSize outputSizeInPixels = currentPixelSize();
 
-    cb->beginPass(m_sc->currentFrameRenderTarget(), Qt::black, {1.0f, 0}, resourceUpdates);
-    cb->setViewport({0, 0, float(outputSizeInPixels.width()), float(outputSizeInPixels.height())});
+    // Level of detail from the size of the bounding sphere on screen, the selected part always at full detail.
+    // All specimens share the draw, so the one closest to the camera decides.
+    std::vector<QMatrix4x4> instanceModelViews(m_instanceCount, m_camera.view());
+    for (int instanceIndex = 0; instanceIndex < m_instanceCount; ++instanceIndex) {
+        instanceModelViews[instanceIndex].translate(m_instanceTranslations[instanceIndex]);
+        instanceModelViews[instanceIndex] *= m_modelRotation;
+    }
+    const float pixelsPerUnit = 0.5f * outputSizeInPixels.height() * m_projection(1, 1);
+    std::vector<const IndexRange *> lods(m_entities.size());
+    bool anyTranslucent = false;
+    for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
+        const auto &entity = m_entities[entityIndex];
+        float depth = std::numeric_limits<float>::max();
+        for (const auto &modelView: instanceModelViews) {
+            depth = std::min(depth, -modelView.map(entity.m_boundsCenter).z());
+        }
+        lods[entityIndex] = entityIndex == m_selectedEntity || depth <= entity.m_boundsRadius
+                                ? &entity.m_drawRange.lods.front()
+                                : &entity.lodForScreenDiameter(2.0f * entity.m_boundsRadius * pixelsPerUnit / depth);
+        anyTranslucent |= entity.m_opacity < 1.0f;
+    }
 
-    for (const auto &entity: m_entities) {
-        if (entity.m_renderingMode == RenderingMode::GreyedOut) {
-            m_colorPipeline->setShaderResourceBindings(entity.m_greyedOutSrb.get());
-        } else {
-            m_colorPipeline->setShaderResourceBindings(entity.m_defaultSrb.get());
+    // the faded (translucent) or the other parts, in one draw each whatever the pipeline
+    const QRhiCommandBuffer::VertexInput vbufBindings[] = {
+        {m_sceneGeometry.vertexBuffer(), 0},
+        {m_instanceBuffer.get(), 0}
+    };
+    m_drawnIndicesLastFrame = 0;
+    const auto drawEntities = [&](const PipelineKey &pipeline, const bool translucent) {
+        cb->setGraphicsPipeline(m_pipelineCache->pipeline(pipeline));
+        cb->setVertexInput(0, 2, vbufBindings, m_sceneGeometry.indexBuffer(), 0, m_sceneGeometry.indexFormat());
+        for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
+            if ((m_entities[entityIndex].m_opacity < 1.0f) != translucent) {
+                continue;
+            }
+            const auto &lod = *lods[entityIndex];
+            const QRhiCommandBuffer::DynamicOffset entityUniforms(1, entityIndex * m_entityUniformStride);
+            cb->setShaderResources(m_sceneSrb.get(), 1, &entityUniforms);
+            cb->drawIndexed(lod.indexCount, m_instanceCount, lod.firstIndex);
+            m_drawnIndicesLastFrame += static_cast<quint64>(lod.indexCount) * m_instanceCount;
+        }
+    };
+
+    const auto drawRays = [&](const PipelineKey &pipeline) {
+        phase.emplace("drawRays");
+        if (m_drawRays) {
+            cb->setGraphicsPipeline(m_pipelineCache->pipeline(pipeline));
+            cb->setShaderResources(m_raySrb.get());
+            const QRhiCommandBuffer::VertexInput rayVbufBinding(m_rayVertexBuffer.get(), 0);
+            cb->setVertexInput(0, 1, &rayVbufBinding);
+            cb->draw(2);
         }
-        m_colorPipeline->create();
-        cb->setGraphicsPipeline(m_colorPipeline.get());
-        cb->setShaderResources();
+    };
+
+    // With faded parts the opaque ones are drawn offscreen, the faded ones are summed up in the same pass in front of
+    // their depth and the composite resolves both onto the frame. Every part is drawn once either way.
+    if (anyTranslucent) {
+        phase.emplace("drawEntities");
+        cb->beginPass(m_translucencyRt.get(), Qt::transparent, {1.0f, 0}, resourceUpdates);
+        resourceUpdates = nullptr;
+        cb->setViewport({0, 0, float(outputSizeInPixels.width()), float(outputSizeInPixels.height())});
+        drawEntities(OFFSCREEN_COLOR_PIPELINE, false);
+        drawRays(OFFSCREEN_RAY_PIPELINE);
+        phase.emplace("drawTranslucent");
+        drawEntities(TRANSLUCENT_PIPELINE, true);
+        cb->endPass();
+    }
+
+    cb->beginPass(currentRenderTarget(), Qt::black, {1.0f, 0}, resourceUpdates);
+    cb->setViewport({0, 0, float(outputSizeInPixels.width()), float(outputSizeInPixels.height())});
 
-        const QRhiCommandBuffer::VertexInput vbufBinding(entity.m_vbuf.get(), 0);
-        cb->setVertexInput(0, 1, &vbufBinding);
-        cb->draw(entity.GetNumVertices());
+    if (anyTranslucent) {
+        phase.emplace("composite");
+        cb->setGraphicsPipeline(m_pipelineCache->pipeline(COMPOSITE_PIPELINE));
+        cb->setShaderResources(m_compositeSrb.get());
+        cb->draw(3);
+    } else {
+        phase.emplace("drawEntities");
+        if (!m_entities.empty()) {
+            drawEntities(COLOR_PIPELINE, false);
+        }
+        drawRays(RAY_PIPELINE);
     }
 
-    if (m_drawRays) {
-        cb->setGraphicsPipeline(m_rayPipeline.get());
-        cb->setShaderResources();
-        const QRhiCommandBuffer::VertexInput rayVbufBinding(m_rayVertexBuffer.get(), 0);
-        cb->setVertexInput(0, 1, &rayVbufBinding);
-        cb->draw(2);
+    if (m_statsOverlayVisible) {
+        phase.emplace("drawOverlay");
+        cb->setGraphicsPipeline(m_pipelineCache->pipeline(OVERLAY_PIPELINE));
+        cb->setShaderResources(m_overlaySrb.get());
+        cb->draw(3);
     }
 
     cb->endPass();
+    phase.reset();
+
+    m_pipelineCreationsLastFrame = m_pipelineCache->pipelineCreations() - pipelineCreationsBefore;
+
+    if (!m_firstFrameReported) {
+        m_firstFrameReported = true;
+        std::cout << "First frame after " << m_processTimer.nsecsElapsed() / 1e6 << " ms" << std::endl;
+    }
+}
+
+bool AppWindow::isAnimating() const {
+    const bool hoverPickPending = m_hoverPicking && m_lastSubmittedHoverSequence != m_lastHoverSequence;
+    // frames keep coming while the model loads, each picks up the parts finished in the meantime
+    return m_selectionTween.playing || hoverPickPending || pendingUpdates != nullptr || m_initialUpdates != nullptr ||
+           !(m_modelLoaded || m_loadFailed);
 }
 
 void AppWindow::handleMouseMove(QMouseEvent *event) {
@@ -487,11 +982,10 @@ void AppWindow::handleMouseMove(QMouseEvent *event) {
         const auto mousePos = event->pos();
         const auto offset = mousePos - m_lastMousePos;
         m_rotationAngles += QVector2D(offset) * m_deltaTime * 20;
-
-        QMatrix4x4 modelRotation;
-        modelRotation.rotate(m_rotationAngles.y(), -1, 0, 0);
-        modelRotation.rotate(m_rotationAngles.x(), 0, 1, 0);
-        m_modelRotation = modelRotation;
+        updateModelRotation();
+    } else {
+        const auto ndc = ndcFromScreen(event->position());
+        requestHoverPick(ndc.x(), ndc.y());
     }
 
     m_lastMousePos = event->pos();
@@ -500,6 +994,8 @@ void AppWindow::handleMouseMove(QMouseEvent *event) {
 void AppWindow::handleMouseButtonPress(QMouseEvent *event) {
     if (event->button() == Qt::LeftButton) {
         m_pressing_down = true;
+        m_hoveredEntity = -1;
+        scheduleRender();
     }
 }
 
@@ -514,101 +1010,524 @@ void AppWindow::handleMouseButtonRelease(QMouseEvent *event) {
 
         const auto screenPosition = event->position();
         std::cout << "Screen pos in pixels: " << screenPosition.x() << ", " << screenPosition.y() << std::endl;
-        const float ndcX = (2.0f * screenPosition.x()) / width() - 1.0f;
-        const float ndcY = 1.0f - (2.0f * screenPosition.y()) / height();
+        const auto ndc = ndcFromScreen(screenPosition);
+        const float ndcX = ndc.x();
+        const float ndcY = ndc.y();
         std::cout << "NDC: " << ndcX << ", " << ndcY << std::endl;
         std::cout << std::endl;
 
-        const QVector4D nearPoint(ndcX, ndcY, -1.0f, 1.0f);
-        const QVector4D farPoint(ndcX, ndcY, 1.0f, 1.0f);
-        const QMatrix4x4 inverseVP = m_viewProjection.inverted();
-
-        QVector4D nearWorld = inverseVP * nearPoint;
-        QVector4D farWorld = inverseVP * farPoint;
-
-        nearWorld /= nearWorld.w();
-        farWorld /= farWorld.w();
-
-        const QVector3D rayOrigin(nearWorld);
-        const QVector3D rayEnd(farWorld);
+        QVector3D rayOrigin;
+        QVector3D rayEnd;
+        rayFromNdc(ndcX, ndcY, rayOrigin, rayEnd);
         const QVector3D rayDir = (rayEnd - rayOrigin).normalized();
 
         pendingUpdates = new float[]{
             rayOrigin.x(), rayOrigin.y(), rayOrigin.z(),
             rayEnd.x(), rayEnd.y(), rayEnd.z()
         };
+        scheduleRender();
 
         // collide with entities
-        int closestEntity = -1;
-        float closestDistance = std::numeric_limits<float>::max();
-        for (int entityIndex = 0; entityIndex < m_entities.size(); ++entityIndex) {
-            const auto &entity = m_entities[entityIndex];
-            assert(entity.m_vertices.size() % 3 == 0);
-            for (int i = 0; i < entity.m_vertices.size() / 3; ++i) {
-                const auto v0 = entity.m_vertices[3 * i];
-                const auto v1 = entity.m_vertices[3 * i + 1];
-                const auto v2 = entity.m_vertices[3 * i + 2];
-
-                const auto result = doesRayIntersectTriangle(rayOrigin, rayDir, v0, v1, v2);
-                if (result.has_value()) {
-                    if (result.value() < closestDistance) {
-                        closestDistance = result.value();
-                        closestEntity = entityIndex;
-                        std::cout << "Closest entity index: " << closestEntity << " with value: " << closestDistance <<
-                                std::endl;
-                    }
-                }
-            }
-        }
+        const auto [closestEntity, closestInstance, closestDistance] =
+                m_pickingScene->pick(rayOrigin, rayDir, instanceOffsets());
         if (closestEntity != -1) {
-            for (int i = 0; i < m_entities.size(); ++i) {
-                if (i == closestEntity) {
-                    m_selectedEntity = closestEntity;
-                    m_entities[i].m_renderingMode = RenderingMode::Normal;
-                } else {
-                    m_entities[i].m_renderingMode = RenderingMode::GreyedOut;
-                }
-            }
-
-            constexpr QVector3D cameraDirView(0, 0, -1.0);
-            const auto centroidWorld = m_modelRotation.map(m_entities[m_selectedEntity].m_centroid);
-            const auto newEye = centroidWorld - cameraDirView;
-
-            m_selectionTween = SelectionTween{
-                m_camera.eye(),
-                newEye,
-                m_camera.center(),
-                centroidWorld,
-                0.2f,
-                0.0f,
-                true,
-                EaseOutCubic
-            };
+            selectEntity(closestEntity, closestInstance);
         } else {
-            m_selectedEntity = -1;
+            // a click next to the model deselects in place, the other parts come back
+            clearSelection(false);
         }
     } else if (event->button() == Qt::RightButton) {
-        if (m_selectedEntity != -1) {
-            for (auto &entity: m_entities) {
-                entity.m_renderingMode = RenderingMode::Normal;
-            }
-            m_selectionTween = SelectionTween{
-                m_camera.eye(),
-                QVector3D(0, 0, 2.5),
-                m_camera.center(),
-                QVector3D(0, 0, 0),
-                0.2f,
-                0.0f,
-                true,
-                EaseOutCubic
-            };
-            m_selectedEntity = -1;
+        clearSelection();
+    }
+}
+
+void AppWindow::rayFromNdc(const float ndcX, const float ndcY, QVector3D &rayOrigin, QVector3D &rayEnd) const {
+    const QVector4D nearPoint(ndcX, ndcY, -1.0f, 1.0f);
+    const QVector4D farPoint(ndcX, ndcY, 1.0f, 1.0f);
+    const QMatrix4x4 inverseVP = m_viewProjection.inverted();
+
+    QVector4D nearWorld = inverseVP * nearPoint;
+    QVector4D farWorld = inverseVP * farPoint;
+
+    nearWorld /= nearWorld.w();
+    farWorld /= farWorld.w();
+
+    rayOrigin = QVector3D(nearWorld);
+    rayEnd = QVector3D(farWorld);
+}
+
+QVector2D AppWindow::ndcFromScreen(const QPointF screenPosition) const {
+    return {
+        static_cast<float>((2.0f * screenPosition.x()) / width() - 1.0f),
+        static_cast<float>(1.0f - (2.0f * screenPosition.y()) / height())
+    };
+}
+
+void AppWindow::requestHoverPick(const float ndcX, const float ndcY) {
+    if (!m_hoverPicking) {
+        return;
+    }
+
+    QVector3D rayOrigin;
+    QVector3D rayEnd;
+    rayFromNdc(ndcX, ndcY, rayOrigin, rayEnd);
+    const auto sequence = m_hoverPicking->submit(rayOrigin, (rayEnd - rayOrigin).normalized(), instanceOffsets());
+    m_hoverRequestNanos[sequence % HOVER_HISTORY_SIZE] = {sequence, m_timer.nsecsElapsed()};
+    m_lastSubmittedHoverSequence = sequence;
+    // frames keep coming until the result is in, see isAnimating
+    scheduleRender();
+}
+
+// picks up whatever the picking thread finished since the last frame
+void AppWindow::applyHoverPick() {
+    if (!m_hoverPicking) {
+        return;
+    }
+
+    const ProfileScope scope("applyHoverPick");
+    const auto hover = m_hoverPicking->latestResult();
+    if (!hover.has_value() || hover->sequence == m_lastHoverSequence) {
+        return;
+    }
+    m_lastHoverSequence = hover->sequence;
+    m_hoveredEntity = m_pressing_down ? -1 : hover->entityIndex;
+    m_hoveredInstance = hover->instanceIndex;
+
+    // the frame being recorded is the first one showing the result
+    const auto &[requestSequence, requestNanos] = m_hoverRequestNanos[hover->sequence % HOVER_HISTORY_SIZE];
+    if (requestSequence == hover->sequence) {
+        m_hoverLatencies.add((m_timer.nsecsElapsed() - requestNanos) / 1e6);
+    }
+}
+
+void AppWindow::updateModelRotation() {
+    QMatrix4x4 modelRotation;
+    modelRotation.rotate(m_rotationAngles.y(), -1, 0, 0);
+    modelRotation.rotate(m_rotationAngles.x(), 0, 1, 0);
+    m_modelRotation = modelRotation;
+    scheduleRender();
+}
+
+// Square grid in the plane facing the home camera, centred on the origin. Specimens rotate about their own origin, so
+// twice the reach of the model apart they never overlap at any rotation.
+void AppWindow::updateInstanceLayout() {
+    const QVector3D previousHomeEye = homeEye();
+
+    m_instanceReach = 0.0f;
+    for (const auto &entity: m_entities) {
+        m_instanceReach = std::max(m_instanceReach, entity.m_boundsCenter.length() + entity.m_boundsRadius);
+    }
+    constexpr float GAP = 1.1f;
+    const float spacing = 2.0f * m_instanceReach * GAP;
+    const int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(m_instanceCount))));
+    const int rows = (m_instanceCount + columns - 1) / columns;
+
+    m_instanceTranslations.resize(m_instanceCount);
+    for (int instanceIndex = 0; instanceIndex < m_instanceCount; ++instanceIndex) {
+        const int column = instanceIndex % columns;
+        const int row = instanceIndex / columns;
+        m_instanceTranslations[instanceIndex] = QVector3D((column - 0.5f * (columns - 1)) * spacing,
+                                                          (0.5f * (rows - 1) - row) * spacing, 0.0f);
+    }
+
+    // the grid grows while parts arrive, an untouched camera backs off with it
+    if (m_selectedEntity == -1 && !m_selectionTween.playing && m_camera.eye() == previousHomeEye) {
+        m_camera.setLookAt(homeEye(), m_camera.center(), m_camera.up());
+    }
+}
+
+void AppWindow::updateInstanceData(QRhiResourceUpdateBatch *resourceUpdates) {
+    // the selected part itself is never lit up, as with a single specimen
+    const bool hoverShown = m_hoveredEntity != -1 &&
+                            (m_hoveredEntity != m_selectedEntity || m_hoveredInstance != m_selectedInstance);
+    for (int instanceIndex = 0; instanceIndex < m_instanceCount; ++instanceIndex) {
+        QMatrix4x4 transform;
+        transform.translate(m_instanceTranslations[instanceIndex]);
+        auto &instance = m_instanceData[instanceIndex];
+        std::memcpy(instance.transform, transform.constData(), sizeof(instance.transform));
+        const bool greyedOut = m_selectedEntity != -1 && instanceIndex != m_selectedInstance;
+        instance.renderingMode = static_cast<qint32>(greyedOut ? RenderingMode::GreyedOut : RenderingMode::Normal);
+        instance.hovered = hoverShown && instanceIndex == m_hoveredInstance ? 1 : 0;
+    }
+    resourceUpdates->updateDynamicBuffer(m_instanceBuffer.get(), 0, m_instanceCount * sizeof(InstanceData),
+                                         m_instanceData.data());
+}
+
+std::vector<QVector3D> AppWindow::instanceOffsets() const {
+    // the rotation is orthonormal, its transpose undoes it
+    const QMatrix4x4 inverseRotation = m_modelRotation.transposed();
+    std::vector<QVector3D> offsets;
+    offsets.reserve(m_instanceTranslations.size());
+    for (const auto &translation: m_instanceTranslations) {
+        offsets.push_back(inverseRotation.map(translation));
+    }
+    return offsets;
+}
+
+QVector3D AppWindow::homeEye() const {
+    if (m_instanceCount == 1) {
+        return {0, 0, 2.5};
+    }
+    // far enough that the outermost specimens fit the vertical field of view, see customInit
+    float halfExtent = 0.0f;
+    for (const auto &translation: m_instanceTranslations) {
+        halfExtent = std::max({halfExtent, std::abs(translation.x()), std::abs(translation.y())});
+    }
+    halfExtent += m_instanceReach;
+    return {0, 0, std::max(2.5f, halfExtent / std::tan(qDegreesToRadians(22.5f)))};
+}
+
+void AppWindow::selectEntity(const int entityIndex, const int instanceIndex) {
+    m_selectedInstance = instanceIndex;
+    for (int i = 0; i < m_entities.size(); ++i) {
+        if (i == entityIndex) {
+            m_selectedEntity = entityIndex;
+            m_entities[i].m_renderingMode = RenderingMode::Normal;
+        } else {
+            m_entities[i].m_renderingMode = RenderingMode::GreyedOut;
         }
     }
+
+    constexpr QVector3D cameraDirView(0, 0, -1.0);
+    const auto centroidWorld = m_instanceTranslations[m_selectedInstance] +
+                               m_modelRotation.map(m_entities[m_selectedEntity].m_centroid);
+    const auto newEye = centroidWorld - cameraDirView;
+
+    m_selectionTween = SelectionTween{
+        m_camera.eye(),
+        newEye,
+        m_camera.center(),
+        centroidWorld,
+        0.2f,
+        0.0f,
+        true,
+        EaseOutCubic
+    };
+    fadeEntities(m_selectedEntity);
+    scheduleRender();
+}
+
+void AppWindow::fadeEntities(const int focusedEntity) {
+    m_selectionTween.startOpacities.clear();
+    m_selectionTween.endOpacities.clear();
+    for (int i = 0; i < m_entities.size(); ++i) {
+        // without the translucency targets the parts are only greyed out
+        const bool faded = m_translucencySupported && focusedEntity != -1 && i != focusedEntity;
+        m_selectionTween.startOpacities.push_back(m_entities[i].m_opacity);
+        m_selectionTween.endOpacities.push_back(faded ? FADED_OPACITY : 1.0f);
+    }
+}
+
+void AppWindow::clearSelection(const bool returnHome) {
+    if (m_selectedEntity == -1) {
+        return;
+    }
+
+    for (auto &entity: m_entities) {
+        entity.m_renderingMode = RenderingMode::Normal;
+    }
+    m_selectionTween = SelectionTween{
+        m_camera.eye(),
+        returnHome ? homeEye() : m_camera.eye(),
+        m_camera.center(),
+        returnHome ? QVector3D(0, 0, 0) : m_camera.center(),
+        0.2f,
+        0.0f,
+        true,
+        EaseOutCubic
+    };
+    fadeEntities(-1);
+    m_selectedEntity = -1;
+    scheduleRender();
 }
 
 void AppWindow::handleWheel(QWheelEvent *event) {
     if (m_selectedEntity == -1) {
         m_camera.zoom(event->angleDelta().y());
+        scheduleRender();
+    }
+}
+
+void AppWindow::handleKeyPress(QKeyEvent *event) {
+    switch (event->key()) {
+        case Qt::Key_F3:
+            m_statsOverlayVisible = !m_statsOverlayVisible;
+            m_statsOverlayUpdatedMillis = -1;
+            scheduleRender();
+            break;
+        case Qt::Key_F12:
+            if (Profiler::instance().writeChromeTrace(m_tracePath)) {
+                std::cout << "Trace written to " << m_tracePath.toStdString() << std::endl;
+            } else {
+                std::cerr << "Could not write the trace to " << m_tracePath.toStdString() << std::endl;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Mean and max of every profiled scope and of the GPU frames over the last second, then memory use.
+QString AppWindow::statsOverlayText() const {
+    const auto &profiler = Profiler::instance();
+    const auto events = profiler.eventsSince(profiler.nowNanos() - 1000000000);
+
+    struct ScopeStats {
+        const char *name;
+        int count;
+        double totalMillis;
+        double maxMillis;
+    };
+    // in the order the scopes first show up, which keeps the lines from jumping around between updates
+    std::vector<ScopeStats> scopes;
+    for (const auto &event: events) {
+        if (event.kind == ProfileEvent::Kind::Counter) {
+            continue;
+        }
+        const double millis = event.durationNanos / 1e6;
+        auto stats = std::find_if(scopes.begin(), scopes.end(), [&](const ScopeStats &s) {
+            return std::strcmp(s.name, event.name) == 0;
+        });
+        if (stats == scopes.end()) {
+            scopes.push_back({event.name, 0, 0.0, 0.0});
+            stats = scopes.end() - 1;
+        }
+        ++stats->count;
+        stats->totalMillis += millis;
+        stats->maxMillis = std::max(stats->maxMillis, millis);
+    }
+
+    const auto frames = std::find_if(scopes.begin(), scopes.end(), [](const ScopeStats &s) {
+        return std::strcmp(s.name, "render") == 0;
+    });
+    QString text = QString::asprintf("%s, %d frames in the last second\n\n", qPrintable(graphicsApiName()),
+                                     frames == scopes.end() ? 0 : frames->count);
+    // "gpu frame" lines below only show up when the backend reports GPU times
+    if (m_lastGpuMillis <= 0.0) {
+        text += QStringLiteral("no GPU timestamps from this backend\n\n");
+    }
+    text += QString::asprintf("%-16s %6s %8s %8s\n", "", "count", "mean ms", "max ms");
+    for (const auto &stats: scopes) {
+        text += QString::asprintf("%-16s %6d %8.3f %8.3f\n", stats.name, stats.count, stats.totalMillis / stats.count,
+                                  stats.maxMillis);
+    }
+
+    quint64 fullDetailIndices = 0;
+    for (const auto &entity: m_entities) {
+        fullDetailIndices += entity.GetNumIndices();
+    }
+    text += QString::asprintf("\ntriangles drawn  %llu of %llu\n",
+                              static_cast<unsigned long long>(m_drawnIndicesLastFrame / 3),
+                              static_cast<unsigned long long>(fullDetailIndices / 3));
+    text += QString::asprintf("gpu vertices     %8.2f MB\n", m_memoryTotals.gpuVertexBytes / 1e6);
+    text += QString::asprintf("gpu indices      %8.2f MB\n", m_memoryTotals.gpuIndexBytes / 1e6);
+    text += QString::asprintf("gpu textures     %8.2f MB\n", m_textureArrayBytes / 1e6);
+    text += QString::asprintf("cpu picking      %8.2f MB\n", m_memoryTotals.cpuPickingBytes / 1e6);
+    if (m_largestEntity >= 0) {
+        const quint32 indexSize = m_sceneGeometry.indexFormat() == QRhiCommandBuffer::IndexUInt16 ? 2 : 4;
+        const auto memory = m_entities[m_largestEntity].memory(indexSize);
+        text += QString::asprintf("largest part     #%d, %.2f MB\n", m_largestEntity,
+                                  (memory.gpuVertexBytes + memory.gpuIndexBytes + memory.cpuPickingBytes) / 1e6);
+    }
+    return text;
+}
+
+// Redraws the overlay text into its texture, twice a second at most. Frames are only rendered on demand,
+// so while nothing moves the overlay keeps showing the numbers of the last frames that were.
+void AppWindow::updateStatsOverlay(QRhiResourceUpdateBatch *resourceUpdates) {
+    const QSize outputSize = currentPixelSize();
+    const qint64 nowMillis = m_timer.elapsed();
+    const bool resized = m_overlayTexture->pixelSize() != outputSize;
+    if (!resized && m_statsOverlayUpdatedMillis >= 0 && nowMillis - m_statsOverlayUpdatedMillis < 500) {
+        return;
+    }
+    m_statsOverlayUpdatedMillis = nowMillis;
+
+    if (resized) {
+        m_overlayTexture->setPixelSize(outputSize);
+        m_overlayTexture->create();
+        m_overlaySrb->create();
+    }
+
+    QImage image(outputSize, QImage::Format_RGBA8888);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    QFont font(QStringLiteral("monospace"));
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(std::max(12, outputSize.height() / 64));
+    painter.setFont(font);
+    const QString text = statsOverlayText();
+    const QRect textRect = painter.boundingRect(QRect(QPoint(0, 0), outputSize).adjusted(16, 16, -16, -16),
+                                                Qt::AlignLeft | Qt::AlignTop, text);
+    painter.fillRect(textRect.adjusted(-8, -8, 8, 8), QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop, text);
+    painter.end();
+
+    // the quad maps the first image row to the bottom of the screen where NDC has y pointing up
+    if (m_rhi->isYUpInNDC()) {
+        image = image.mirrored();
+    }
+    resourceUpdates->uploadTexture(m_overlayTexture.get(), image);
+}
+
+// The path is split into four equally long phases: free rotation, zooming in and back out,
+// selecting every entity in turn (each selection plays a full SelectionTween) and deselecting while rotating.
+void AppWindow::advanceBenchmarkPath(const int frame, const int frameCount) {
+    const int phaseLength = std::max(frameCount / 4, 1);
+    const int phase = frame / phaseLength;
+    const int phaseFrame = frame % phaseLength;
+
+    switch (phase) {
+        case 0:
+            m_rotationAngles += QVector2D(1.5f, 0.5f);
+            updateModelRotation();
+            break;
+        case 1:
+            m_camera.zoom(phaseFrame < phaseLength / 2 ? 120.0f : -120.0f);
+            break;
+        case 2: {
+            if (m_entities.empty()) {
+                break;
+            }
+            const int framesPerSelection = std::max(phaseLength / static_cast<int>(m_entities.size()), 1);
+            if (phaseFrame % framesPerSelection == 0) {
+                const int selection = phaseFrame / framesPerSelection;
+                selectEntity(selection % static_cast<int>(m_entities.size()), selection % m_instanceCount);
+            }
+            break;
+        }
+        default:
+            if (phaseFrame == 0) {
+                clearSelection();
+            }
+            m_rotationAngles -= QVector2D(1.5f, 0.5f);
+            updateModelRotation();
+            break;
+    }
+}
+
+int AppWindow::runBenchmark(const BenchmarkOptions &options) {
+    if (!initOffscreen(options.pixelSize)) {
+        std::cerr << "Error creating offscreen render target" << std::endl;
+        return 1;
+    }
+
+    // 60 Hz playback regardless of how fast the frames are actually produced
+    m_fixedDeltaTime = 1.0f / 60.0f;
+
+    BenchmarkReport report;
+    report.backend = graphicsApiName();
+    report.frameCount = options.frameCount;
+    report.instances = m_instanceCount;
+    report.frameTimes.reserve(options.frameCount);
+    report.customRenderTimes.reserve(options.frameCount);
+
+    // the first frame goes out before the model has finished loading, the timed frames start once it has
+    if (!renderOffscreenFrame()) {
+        std::cerr << "Error rendering the first benchmark frame" << std::endl;
+        return 1;
+    }
+    report.startupMillis = options.processTimer.nsecsElapsed() / 1e6;
+    while (!m_modelLoaded) {
+        // also before the loader started, see customInit
+        if (m_loadFailed) {
+            return 1;
+        }
+        m_modelLoader->waitForProgress(std::chrono::milliseconds(16));
+        if (!renderOffscreenFrame()) {
+            std::cerr << "Error rendering benchmark frame while loading" << std::endl;
+            return 1;
+        }
+    }
+    report.fullyLoadedMillis = m_fullyLoadedMillis;
+
+    // everything built up front and while loading, frames should not add to it
+    report.stateCache.pipelines = m_pipelineCache->pipelineCreations();
+
+    QElapsedTimer frameTimer;
+    quint64 drawnIndices = 0;
+    for (int frame = 0; frame < options.frameCount; ++frame) {
+        frameTimer.start();
+        advanceBenchmarkPath(frame, options.frameCount);
+        // the cursor keeps sweeping over the model, as if the user was hovering while watching
+        requestHoverPick(0.6f * std::sin(frame * 0.05f), 0.4f * std::cos(frame * 0.07f));
+        if (!renderOffscreenFrame()) {
+            std::cerr << "Error rendering benchmark frame " << frame << std::endl;
+            return 1;
+        }
+        report.frameTimes.add(frameTimer.nsecsElapsed() / 1e6);
+        report.customRenderTimes.add(m_lastCustomRenderNanos / 1e6);
+        // offscreen frames are waited for, so this is the GPU time of the previous one
+        if (m_lastGpuMillis > 0.0) {
+            report.gpuFrameTimes.add(m_lastGpuMillis);
+        }
+        report.stateCache.maxPipelineCreationsPerFrame =
+                std::max(report.stateCache.maxPipelineCreationsPerFrame, m_pipelineCreationsLastFrame);
+        drawnIndices += m_drawnIndicesLastFrame;
+    }
+
+    report.hoverRequests = options.frameCount;
+    report.hoverCoalesced = m_hoverPicking->coalescedCount();
+    report.hoverLatencies = m_hoverLatencies;
+
+    report.stateCache.pipelineCreationsDuringFrames = m_pipelineCache->pipelineCreations() - report.stateCache.pipelines;
+
+    for (const auto &entity: m_entities) {
+        report.geometry.vertices += entity.GetNumVertices();
+        report.geometry.indices += entity.GetNumIndices();
+    }
+    report.geometry.vertexBytes = m_sceneGeometry.vertexBuffer()->size();
+    report.geometry.indexBytes = m_sceneGeometry.indexBuffer()->size();
+    report.geometry.meanDrawnIndices = options.frameCount > 0 ? static_cast<double>(drawnIndices) / options.frameCount : 0.0;
+
+    const auto layerSize = m_textureArray->pixelSize();
+    report.textures.encoding = m_textureEncoding == TextureEncoding::BC1 ? QStringLiteral("bc1") : QStringLiteral("rgba8");
+    report.textures.layers = m_textureArray->arraySize();
+    report.textures.levels = TextureCache::mipLevelCount(layerSize);
+    report.textures.bytes = static_cast<qint64>(TextureCache::mipChainSize(layerSize, m_textureEncoding)) *
+                            report.textures.layers;
+    report.textures.rgba8TopLevelBytes = static_cast<qint64>(layerSize.width()) * layerSize.height() * 4 *
+                                         report.textures.layers;
+
+    benchmarkPicking(report.picking);
+    report.write(options.outputPath);
+    return 0;
+}
+
+// casts a grid of rays over the whole viewport, with the camera where the path left it
+void AppWindow::benchmarkPicking(PickingBenchmark &result) const {
+    constexpr int GRID_SIZE = 32;
+
+    QElapsedTimer timer;
+    for (int y = 0; y < GRID_SIZE; ++y) {
+        for (int x = 0; x < GRID_SIZE; ++x) {
+            const float ndcX = lerp(-0.95f, 0.95f, x / float(GRID_SIZE - 1));
+            const float ndcY = lerp(-0.95f, 0.95f, y / float(GRID_SIZE - 1));
+            QVector3D rayOrigin;
+            QVector3D rayEnd;
+            rayFromNdc(ndcX, ndcY, rayOrigin, rayEnd);
+            const QVector3D rayDir = (rayEnd - rayOrigin).normalized();
+
+            timer.start();
+            const auto linear = m_pickingScene->pickLinear(rayOrigin, rayDir);
+            result.linearMillis += timer.nsecsElapsed() / 1e6;
+
+            timer.start();
+            const auto vectorized = m_pickingScene->pickLinearVectorized(rayOrigin, rayDir);
+            result.linearVectorizedMillis += timer.nsecsElapsed() / 1e6;
+
+            timer.start();
+            const auto accelerated = m_pickingScene->pick(rayOrigin, rayDir);
+            result.bvhMillis += timer.nsecsElapsed() / 1e6;
+
+            result.rays++;
+            if (linear.entityIndex != -1) {
+                result.hits++;
+            }
+            if (linear.entityIndex != accelerated.entityIndex || linear.entityIndex != vectorized.entityIndex) {
+                result.mismatches++;
+            }
+        }
     }
 }
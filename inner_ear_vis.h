@@ -4,12 +4,20 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 
+#include <array>
+#include <unordered_map>
+#include <vector>
 #include <QWindow>
 #include <QOffscreenSurface>
 #include <rhi/qrhi.h>
 
+#include "Benchmark.h"
 #include "Camera.h"
 #include "Entity.h"
+#include "ModelLoader.h"
+#include "PickingService.h"
+#include "PipelineCache.h"
+#include "SceneGeometry.h"
 #include "assimp/texture.h"
 #include "vendor/easing/easing.h"
 
@@ -22,6 +30,9 @@ struct SelectionTween {
     float timerSeconds = 0.0f;
     bool playing = false;
     easing_functions easingFunction = EaseInCubic;
+    // per entity, parts fade along with the camera move, see AppWindow::fadeEntities
+    std::vector<float> startOpacities;
+    std::vector<float> endOpacities;
 };
 
 class RhiWindow : public QWindow
@@ -31,9 +42,29 @@ public:
     QString graphicsApiName() const;
     void releaseSwapChain();
 
+    // headless rendering into a texture, without a swapchain or an exposed window
+    bool initOffscreen(QSize pixelSize);
+    bool renderOffscreenFrame();
+
+    // redraw every vsync instead of only when something changed, for measuring
+    void setContinuousRendering(bool continuous);
+
 protected:
     virtual void customInit() = 0;
     virtual void customRender() = 0;
+    // true while the next frame will look different on its own (animations, pending results or uploads)
+    virtual bool isAnimating() const {
+        return false;
+    }
+
+    // Frames are only rendered on request: call this whenever the state shown on screen changes.
+    // Several calls before the frame is rendered result in a single frame.
+    void scheduleRender();
+
+    // valid within customRender() both for the swapchain and for the offscreen target
+    QRhiCommandBuffer *currentCommandBuffer() const;
+    QRhiRenderTarget *currentRenderTarget() const;
+    QSize currentPixelSize() const;
 
 #if QT_CONFIG(opengl)
     std::unique_ptr<QOffscreenSurface> m_fallbackSurface;
@@ -49,6 +80,7 @@ protected:
     virtual void handleMouseButtonPress(QMouseEvent *event) = 0;
     virtual void handleMouseButtonRelease(QMouseEvent *event) = 0;
     virtual void handleWheel(QWheelEvent *event) = 0;
+    virtual void handleKeyPress(QKeyEvent *event) = 0;
 
     QPoint m_lastMousePos;
     bool m_rotating = false;
@@ -58,6 +90,11 @@ protected:
     QElapsedTimer m_timer;
     qint64 m_lastElapsedMillis;
     float m_deltaTime = 0;
+    // when positive, replaces the wall clock delta time (deterministic benchmark playback)
+    float m_fixedDeltaTime = 0;
+    qint64 m_lastCustomRenderNanos = 0;
+    // of the last frame the backend reported, zero until then
+    double m_lastGpuMillis = 0.0;
 
     QMatrix4x4 m_projection;
     QMatrix4x4 m_modelRotation;
@@ -65,9 +102,13 @@ protected:
     Camera m_camera;
 
 private:
+    void createRhi();
     void init();
     void resizeSwapChain();
+    void updateProjection(QSize outputSize);
     void render();
+    void timedCustomRender();
+    void recordGpuTime();
 
     void exposeEvent(QExposeEvent *) override;
     bool event(QEvent *) override;
@@ -76,6 +117,18 @@ private:
     bool m_initialized = false;
     bool m_notExposed = false;
     bool m_newlyExposed = false;
+
+    bool m_renderScheduled = false;
+    bool m_continuousRendering = false;
+    // no frame was scheduled after the last one, the next delta time starts from zero
+    bool m_idle = true;
+    // profiler time at which the last frame was handed to the GPU
+    qint64 m_lastFrameSubmitNanos = 0;
+
+    bool m_offscreen = false;
+    std::unique_ptr<QRhiTexture> m_offscreenTexture;
+    std::unique_ptr<QRhiTextureRenderTarget> m_offscreenRt;
+    QRhiCommandBuffer *m_offscreenCb = nullptr;
 };
 
 class AppWindow : public RhiWindow
@@ -85,31 +138,173 @@ public:
 
     void customInit() override;
     void customRender() override;
+    bool isAnimating() const override;
 
     void handleMouseMove(QMouseEvent *event) override;
     void handleMouseButtonPress(QMouseEvent *event) override;
     void handleMouseButtonRelease(QMouseEvent *event) override;
     void handleWheel(QWheelEvent *event) override;
+    void handleKeyPress(QKeyEvent *event) override;
+
+    // replays a fixed camera path offscreen and prints frame time statistics
+    int runBenchmark(const BenchmarkOptions &options);
+
+    // FBX or anything else assimp reads, or a Draco package (.drc, .glb, .gltf), see DracoPackage
+    void setModelPath(const QString &modelPath) {
+        m_modelPath = modelPath;
+    }
+
+    void setMeshCacheEnabled(const bool enabled) {
+        m_meshCacheEnabled = enabled;
+    }
+
+    // assimp reads the model through a memory mapping, see MappedIOSystem
+    void setMappedImportEnabled(const bool enabled) {
+        m_mappedImportEnabled = enabled;
+    }
+
+    // startup times are reported relative to it
+    void setProcessTimer(const QElapsedTimer &processTimer) {
+        m_processTimer = processTimer;
+    }
+
+    // F3 toggles it at runtime
+    void setStatsOverlayVisible(const bool visible) {
+        m_statsOverlayVisible = visible;
+    }
+
+    // specimens of the comparison view, laid out in a square grid and drawn instanced, 1 to MAX_INSTANCES
+    void setInstanceCount(const int instanceCount) {
+        m_instanceCount = instanceCount;
+    }
+
+    static constexpr int MAX_INSTANCES = 64;
+
+    // where F12 writes the profiler trace
+    void setTracePath(const QString &tracePath) {
+        m_tracePath = tracePath;
+    }
 private:
-    std::unique_ptr<QRhiBuffer> m_normalUbuf;
-    std::unique_ptr<QRhiBuffer> m_greyedOutUbuf;
+    void applyModelLayout(const ModelLayout &layout);
+    void applyLoadProgress(QRhiResourceUpdateBatch *resourceUpdates);
+    // reports why the model can't be shown and leaves app.exec() in main, frames draw nothing from then on
+    void failLoading(const QString &error);
+    void updateModelRotation();
+    void updateInstanceLayout();
+    void updateInstanceData(QRhiResourceUpdateBatch *resourceUpdates);
+    // instance translations moved into model space, where the rays of rayFromNdc are
+    std::vector<QVector3D> instanceOffsets() const;
+    // where the camera starts and returns to after a selection, far enough back for the whole grid
+    QVector3D homeEye() const;
+    void selectEntity(int entityIndex, int instanceIndex);
+    // returnHome moves the camera back to homeEye, otherwise it stays where it is
+    void clearSelection(bool returnHome = true);
+    // every entity but the one in focus fades to translucency, all of them back to opaque without one
+    void fadeEntities(int focusedEntity);
+    // (re)creates the offscreen targets of the translucency pass at the size of the frame, false when the backend
+    // can't create them
+    bool updateTranslucencyTargets(QSize outputSize);
+    // every part opaque from now on, faded ones are only greyed out
+    void disableTranslucency();
+    void advanceBenchmarkPath(int frame, int frameCount);
+    void benchmarkPicking(PickingBenchmark &result) const;
+
+    QVector2D ndcFromScreen(QPointF screenPosition) const;
+    void rayFromNdc(float ndcX, float ndcY, QVector3D &rayOrigin, QVector3D &rayEnd) const;
+    void requestHoverPick(float ndcX, float ndcY);
+    void applyHoverPick();
+    void updateMemoryTotals();
+    QString statsOverlayText() const;
+    void updateStatsOverlay(QRhiResourceUpdateBatch *resourceUpdates);
+
+    // matrices, shared by every draw
+    std::unique_ptr<QRhiBuffer> m_frameUbuf;
+    // EntityUniforms per entity, m_entityUniformStride apart
+    std::unique_ptr<QRhiBuffer> m_entityUbuf;
+    QByteArray m_entityUniforms;
+    quint32 m_entityUniformStride = 0;
+    std::unique_ptr<QRhiTexture> m_textureArray;
+    TextureEncoding m_textureEncoding = TextureEncoding::RGBA8;
     std::unique_ptr<QRhiSampler> m_sampler;
-    std::unique_ptr<QRhiGraphicsPipeline> m_colorPipeline;
+    std::unique_ptr<QRhiShaderResourceBindings> m_sceneSrb;
+    // InstanceData per specimen, the per instance vertex input of the color pipeline
+    std::unique_ptr<QRhiBuffer> m_instanceBuffer;
+    std::vector<InstanceData> m_instanceData;
+    int m_instanceCount = 1;
+    // grid positions in world space, spaced by the model bounds once parts have arrived
+    std::vector<QVector3D> m_instanceTranslations;
+    // farthest any part gets from the model origin, at every rotation
+    float m_instanceReach = 0.0f;
+    SceneGeometry m_sceneGeometry;
+    // every pipeline, built in customInit
+    std::unique_ptr<PipelineCache> m_pipelineCache;
+    quint64 m_pipelineCreationsLastFrame = 0;
+    // after level of detail selection
+    quint64 m_drawnIndicesLastFrame = 0;
+
+    // Weighted blended order-independent transparency of the faded parts. While there are any, the frame is drawn
+    // offscreen in one pass: the opaque parts into the first attachment and the depth buffer, then the faded ones sum
+    // up their weighted colors and the log of their transmittance in front of that depth. A full screen triangle
+    // resolves it onto the swapchain. No sorting, the parts are drawn in any order. Off without float render targets.
+    bool m_translucencySupported = false;
+    std::unique_ptr<QRhiTexture> m_opaqueTexture;
+    std::unique_ptr<QRhiTexture> m_accumulationTexture;
+    std::unique_ptr<QRhiTexture> m_transmittanceTexture;
+    std::unique_ptr<QRhiRenderBuffer> m_translucencyDepth;
+    std::unique_ptr<QRhiTextureRenderTarget> m_translucencyRt;
+    std::unique_ptr<QRhiRenderPassDescriptor> m_translucencyRp;
+    std::unique_ptr<QRhiSampler> m_translucencySampler;
+    std::unique_ptr<QRhiShaderResourceBindings> m_compositeSrb;
 
-    std::unique_ptr<QRhiGraphicsPipeline> m_rayPipeline;
     std::unique_ptr<QRhiShaderResourceBindings> m_raySrb;
     std::unique_ptr<QRhiBuffer> m_rayVertexBuffer;
     std::unique_ptr<QRhiBuffer> m_rayUniformBuffer;
     float* pendingUpdates = nullptr;
 
+    QString m_modelPath = QStringLiteral("../resources/inner_ear.fbx");
+    // vertex data and textures are uploaded straight from it, kept for the lifetime of the window
+    bool m_meshCacheEnabled = true;
+    bool m_mappedImportEnabled = true;
+    std::unique_ptr<ModelLoader> m_modelLoader;
+    bool m_modelLoaded = false;
+    // the loader gave up, nothing more arrives
+    bool m_loadFailed = false;
+    std::unordered_map<unsigned int, int> m_materialIndexToLayer;
+    // texture array layers whose image has been uploaded already
+    std::vector<bool> m_uploadedLayers;
+    QElapsedTimer m_processTimer;
+    bool m_firstFrameReported = false;
+    double m_fullyLoadedMillis = 0.0;
     std::vector<Entity> m_entities;
+    std::shared_ptr<const PickingScene> m_pickingScene;
     int m_selectedEntity = -1;
+    int m_selectedInstance = 0;
+
+    // hover highlighting, picked off the GUI thread
+    std::unique_ptr<PickingService> m_hoverPicking;
+    int m_hoveredEntity = -1;
+    int m_hoveredInstance = 0;
+    uint32_t m_lastHoverSequence = 0;
+    uint32_t m_lastSubmittedHoverSequence = 0;
+    // m_timer timestamps of the mouse events behind recent hover requests, indexed by sequence
+    static constexpr uint32_t HOVER_HISTORY_SIZE = 64;
+    std::array<std::pair<uint32_t, qint64>, HOVER_HISTORY_SIZE> m_hoverRequestNanos{};
+    FrameTimings m_hoverLatencies;
+
+    // frame statistics over the last second, drawn as text into a texture and blended over the frame
+    bool m_statsOverlayVisible = false;
+    qint64 m_statsOverlayUpdatedMillis = -1;
+    std::unique_ptr<QRhiTexture> m_overlayTexture;
+    std::unique_ptr<QRhiSampler> m_overlaySampler;
+    std::unique_ptr<QRhiShaderResourceBindings> m_overlaySrb;
+    QString m_tracePath = QStringLiteral("inner_ear_vis-trace.json");
+    EntityMemory m_memoryTotals;
+    quint64 m_textureArrayBytes = 0;
+    int m_largestEntity = -1;
 
     QRhiResourceUpdateBatch *m_initialUpdates = nullptr;
 
     float m_rotation = 0;
-    float m_opacity = 1.0f;
-    int m_opacityDir = -1;
     bool m_drawRays = false;
 
     SelectionTween m_selectionTween;
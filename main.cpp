@@ -3,10 +3,27 @@
 
 #include <QGuiApplication>
 #include <QCommandLineParser>
+#include <iostream>
 #include "inner_ear_vis.h"
+#include "Profiler.h"
+
+// the profiler keeps recording either way, this only dumps what is still in its ring buffer
+static void writeTrace(const QString &tracePath)
+{
+    if (tracePath.isEmpty())
+        return;
+    if (Profiler::instance().writeChromeTrace(tracePath))
+        std::cout << "Trace written to " << tracePath.toStdString() << std::endl;
+    else
+        std::cerr << "Could not write the trace to " << tracePath.toStdString() << std::endl;
+}
 
 int main(int argc, char **argv)
 {
+    BenchmarkOptions benchmarkOptions;
+    benchmarkOptions.processTimer.start();
+    Profiler::instance().setThreadName("GUI");
+
     QGuiApplication app(argc, argv);
 
     QRhi::Implementation graphicsApi;
@@ -35,6 +52,44 @@ int main(int argc, char **argv)
     cmdLineParser.addOption(d3d12Option);
     QCommandLineOption mtlOption({ "m", "metal" }, QLatin1String("Metal"));
     cmdLineParser.addOption(mtlOption);
+    QCommandLineOption benchmarkOption({ "b", "benchmark" },
+                                       QLatin1String("Render <frames> frames of a scripted camera path offscreen "
+                                                     "and print frame time statistics as JSON"),
+                                       QLatin1String("frames"));
+    cmdLineParser.addOption(benchmarkOption);
+    QCommandLineOption benchmarkOutputOption("benchmark-output",
+                                             QLatin1String("Also write the benchmark JSON report to <file>"),
+                                             QLatin1String("file"));
+    cmdLineParser.addOption(benchmarkOutputOption);
+    QCommandLineOption noMeshCacheOption("no-mesh-cache",
+                                         QLatin1String("Always import the model with assimp, "
+                                                       "neither reading nor writing the mesh cache"));
+    cmdLineParser.addOption(noMeshCacheOption);
+    QCommandLineOption noMappedImportOption("no-mapped-import",
+                                            QLatin1String("Have assimp copy the model to memory instead of reading it "
+                                                          "through a memory mapping"));
+    cmdLineParser.addOption(noMappedImportOption);
+    QCommandLineOption continuousOption("continuous",
+                                        QLatin1String("Redraw every frame instead of only when something changed"));
+    cmdLineParser.addOption(continuousOption);
+    QCommandLineOption modelOption("model",
+                                   QLatin1String("Load <file> instead of the bundled FBX, Draco packages "
+                                                 "(.drc, .glb, .gltf) included"),
+                                   QLatin1String("file"));
+    cmdLineParser.addOption(modelOption);
+    QCommandLineOption specimensOption("specimens",
+                                       QStringLiteral("Show <count> copies of the model side by side in a grid, "
+                                                      "1 to %1").arg(AppWindow::MAX_INSTANCES),
+                                       QLatin1String("count"));
+    cmdLineParser.addOption(specimensOption);
+    QCommandLineOption statsOption("stats",
+                                   QLatin1String("Show frame timings and memory use over the scene, F3 toggles it"));
+    cmdLineParser.addOption(statsOption);
+    QCommandLineOption traceOption("trace",
+                                   QLatin1String("Write the profiler trace (chrome://tracing, Perfetto) to <file> "
+                                                 "on exit, F12 writes it at any time"),
+                                   QLatin1String("file"));
+    cmdLineParser.addOption(traceOption);
 
     cmdLineParser.process(app);
     if (cmdLineParser.isSet(nullOption))
@@ -70,7 +125,37 @@ int main(int argc, char **argv)
 //! [api-setup]
 
     AppWindow window(graphicsApi);
+    if (cmdLineParser.isSet(modelOption))
+        window.setModelPath(cmdLineParser.value(modelOption));
+    if (cmdLineParser.isSet(specimensOption)) {
+        bool validSpecimenCount = false;
+        const int specimenCount = cmdLineParser.value(specimensOption).toInt(&validSpecimenCount);
+        if (!validSpecimenCount || specimenCount < 1 || specimenCount > AppWindow::MAX_INSTANCES)
+            cmdLineParser.showHelp(1);
+        window.setInstanceCount(specimenCount);
+    }
+    window.setMeshCacheEnabled(!cmdLineParser.isSet(noMeshCacheOption));
+    window.setMappedImportEnabled(!cmdLineParser.isSet(noMappedImportOption));
+    window.setProcessTimer(benchmarkOptions.processTimer);
+    window.setStatsOverlayVisible(cmdLineParser.isSet(statsOption));
+    const QString tracePath = cmdLineParser.value(traceOption);
+    if (!tracePath.isEmpty())
+        window.setTracePath(tracePath);
 
+    if (cmdLineParser.isSet(benchmarkOption)) {
+        bool validFrameCount = false;
+        benchmarkOptions.frameCount = cmdLineParser.value(benchmarkOption).toInt(&validFrameCount);
+        if (!validFrameCount || benchmarkOptions.frameCount <= 0)
+            cmdLineParser.showHelp(1);
+        benchmarkOptions.outputPath = cmdLineParser.value(benchmarkOutputOption);
+
+        // the window is never shown, everything is rendered into an offscreen texture
+        const int benchmarkResult = window.runBenchmark(benchmarkOptions);
+        writeTrace(tracePath);
+        return benchmarkResult;
+    }
+
+    window.setContinuousRendering(cmdLineParser.isSet(continuousOption));
     window.resize(1280, 720);
     window.setTitle(QCoreApplication::applicationName() + QLatin1String(" - ") + window.graphicsApiName());
     window.show();
@@ -86,5 +171,7 @@ int main(int argc, char **argv)
     if (window.handle())
         window.releaseSwapChain();
 
+    writeTrace(tracePath);
+
     return ret;
 }
@@ -3,16 +3,23 @@
 layout(location = 0) in vec3 v_color;
 layout(location = 1) in vec3 v_normal;
 layout(location = 2) in vec2 v_tex_coords;
+layout(location = 3) flat in int v_instance_mode;
+layout(location = 4) flat in int v_instance_hovered;
 
 layout(location = 0) out vec4 fragColor;
 
-layout(std140, binding = 0) uniform buf {
-    mat4 model_rotation;
-    mat4 view_projection;
+// per entity, bound at a dynamic offset for every draw
+layout(std140, binding = 1) uniform entity_buf {
     int rendering_mode;
+    float opacity;
+    int texture_layer;
+    int hovered;
+    // for color.vert
+    vec4 position_offset;
+    vec4 position_scale;
 };
 
-layout(binding = 1) uniform sampler2D diffuse_texture;
+layout(binding = 2) uniform sampler2DArray diffuse_textures;
 
 void main()
 {
@@ -22,18 +29,26 @@ void main()
     vec3 diffuse = light_color * diff;
     vec3 ambient = vec3(0.4, 0.4, 0.4);
 
-    if (rendering_mode == 0) {
+    // the hovered part lights up in the specimen under the cursor only, other specimens grey out during a selection
+    bool highlighted = hovered != 0 && v_instance_hovered != 0;
+    bool greyed_out = !highlighted && (rendering_mode == 1 || v_instance_mode == 1);
+
+    if (!greyed_out) {
         // one mesh doesn't have UV coordinates / texture, a small hack :)
         vec3 diff_color = vec3(0.9, 0.8, 0.9);
-        if (v_tex_coords.x > 0.001) {
-            diff_color = texture(diffuse_texture, v_tex_coords).xyz;
+        if (texture_layer >= 0 && v_tex_coords.x > 0.001) {
+            diff_color = texture(diffuse_textures, vec3(v_tex_coords, float(texture_layer))).xyz;
         }
 
         vec3 result = (ambient + diffuse) * diff_color;
-        fragColor = vec4(result, 1.0);
+        if (highlighted) {
+            // hovered, lifted towards white
+            result = mix(result, vec3(1.0, 1.0, 1.0), 0.3);
+        }
+        fragColor = vec4(result * opacity, opacity);
     } else {
         vec3 diff_color = vec3(0.4, 0.4, 0.4);
         vec3 result = (ambient + diffuse) * diff_color;
-        fragColor = vec4(result, 1.0);
+        fragColor = vec4(result * opacity, opacity);
     }
 }
@@ -1,24 +1,78 @@
 #version 440
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 tex_coords;
+// one QuantizedVertex: 16 bit steps across the mesh bounding box, octahedral normal, half float UV
+layout(location = 0) in uvec4 quantized;
+// per instance, one specimen of the comparison view
+layout(location = 3) in vec4 instance_column0;
+layout(location = 4) in vec4 instance_column1;
+layout(location = 5) in vec4 instance_column2;
+layout(location = 6) in vec4 instance_column3;
+layout(location = 7) in int instance_mode;
+layout(location = 8) in int instance_hovered;
 
 layout(location = 0) out vec3 v_color;
 layout(location = 1) out vec3 v_normal;
 layout(location = 2) out vec2 v_tex_coords;
+layout(location = 3) flat out int v_instance_mode;
+layout(location = 4) flat out int v_instance_hovered;
+// distance from the camera, weighs translucent fragments in color_translucent.frag
+layout(location = 5) out float v_view_depth;
 
 layout(std140, binding = 0) uniform buf {
     mat4 model_rotation;
     mat4 view_projection;
+};
+
+// per entity, bound at a dynamic offset for every draw
+layout(std140, binding = 1) uniform entity_buf {
     int rendering_mode;
+    float opacity;
+    int texture_layer;
+    int hovered;
+    vec4 position_offset;
+    vec4 position_scale;
 };
 
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+// unpackSnorm2x16 and unpackHalf2x16 are GLSL 4.20 on desktop GL, decoded by hand to keep the 330 target
+vec2 snorm16_decode(uint packed)
+{
+    // the casts keep the bits, the right shifts bring the sign along
+    ivec2 halves = ivec2(int(packed << 16), int(packed)) >> 16;
+    return max(vec2(halves) / 32767.0, -1.0);
+}
+
+float half_decode(uint bits)
+{
+    uint exponent = (bits >> 10) & 0x1fu;
+    uint mantissa = bits & 0x3ffu;
+    // subnormal halves are normal floats, the rest moves to the float bias of 127 instead of 15
+    float magnitude = exponent == 0u ? float(mantissa) * exp2(-24.0)
+                                     : uintBitsToFloat(((exponent + 112u) << 23) | (mantissa << 13));
+    return (bits & 0x8000u) != 0u ? -magnitude : magnitude;
+}
+
 void main()
 {
+    mat4 instance_transform = mat4(instance_column0, instance_column1, instance_column2, instance_column3);
+    uvec3 position = uvec3(quantized.x & 0xffffu, quantized.x >> 16, quantized.y & 0xffffu);
+    vec3 model_position = position_offset.xyz + vec3(position) * position_scale.xyz;
+    vec3 model_normal = octahedral_decode(snorm16_decode(quantized.z));
+    vec2 tex_coords = vec2(half_decode(quantized.w & 0xffffu), half_decode(quantized.w >> 16));
     v_color = vec3(tex_coords.x, tex_coords.y, 0.0);
     // no scaling in model mat, no need to do extra work to keep normal orthogonal
-    v_normal = mat3(model_rotation) * normal;
+    v_normal = mat3(instance_transform) * mat3(model_rotation) * model_normal;
     v_tex_coords = tex_coords;
-    gl_Position = view_projection * model_rotation * vec4(position, 1.0);
+    v_instance_mode = instance_mode;
+    v_instance_hovered = instance_hovered;
+    gl_Position = view_projection * instance_transform * model_rotation * vec4(model_position, 1.0);
+    v_view_depth = gl_Position.w;
 }
@@ -0,0 +1,62 @@
+#version 440
+
+layout(location = 0) in vec3 v_color;
+layout(location = 1) in vec3 v_normal;
+layout(location = 2) in vec2 v_tex_coords;
+layout(location = 3) flat in int v_instance_mode;
+layout(location = 4) flat in int v_instance_hovered;
+layout(location = 5) in float v_view_depth;
+
+// weighted blended order-independent transparency (McGuire and Bavoil 2013), both targets are summed up,
+// location 0 holds the opaque parts and is left alone
+// weighted premultiplied color and weight
+layout(location = 1) out vec4 accumulation;
+// -log(1 - alpha), the sum is the log of the product of the transmittances
+layout(location = 2) out vec4 transmittance;
+
+// per entity, bound at a dynamic offset for every draw
+layout(std140, binding = 1) uniform entity_buf {
+    int rendering_mode;
+    float opacity;
+    int texture_layer;
+    int hovered;
+    // for color.vert
+    vec4 position_offset;
+    vec4 position_scale;
+};
+
+layout(binding = 2) uniform sampler2DArray diffuse_textures;
+
+void main()
+{
+    // lit as in color.frag
+    vec3 light_dir = vec3(0.0, 1.0, 0.0);
+    vec3 light_color = vec3(1.0, 1.0, 1.0);
+    float diff = max(dot(light_dir, v_normal), 0.0);
+    vec3 diffuse = light_color * diff;
+    vec3 ambient = vec3(0.4, 0.4, 0.4);
+
+    bool highlighted = hovered != 0 && v_instance_hovered != 0;
+    bool greyed_out = !highlighted && (rendering_mode == 1 || v_instance_mode == 1);
+
+    vec3 diff_color = vec3(0.4, 0.4, 0.4);
+    if (!greyed_out) {
+        diff_color = vec3(0.9, 0.8, 0.9);
+        if (texture_layer >= 0 && v_tex_coords.x > 0.001) {
+            diff_color = texture(diffuse_textures, vec3(v_tex_coords, float(texture_layer))).xyz;
+        }
+    }
+    vec3 result = (ambient + diffuse) * diff_color;
+    if (highlighted) {
+        result = mix(result, vec3(1.0, 1.0, 1.0), 0.3);
+    }
+
+    // fully opaque would make the transmittance log infinite
+    float alpha = clamp(opacity, 0.0, 0.999);
+    // equation 7 of the paper, nearer layers count for more. A tenth of it, so that a couple of hundred layers still
+    // sum up within half float range
+    float weight = alpha * clamp(1.0 / (1e-5 + pow(v_view_depth / 5.0, 2.0) + pow(v_view_depth / 200.0, 6.0)),
+                                 1e-3, 3e2);
+    accumulation = vec4(result * alpha, alpha) * weight;
+    transmittance = vec4(-log(1.0 - alpha));
+}
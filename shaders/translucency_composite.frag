@@ -0,0 +1,20 @@
+#version 440
+
+layout(location = 0) in vec2 v_uv;
+layout(location = 0) out vec4 fragColor;
+
+// the offscreen pass, the same size as the frame: the opaque parts and what color_translucent.frag summed up
+layout(binding = 0) uniform sampler2D opaque;
+layout(binding = 1) uniform sampler2D accumulation;
+layout(binding = 2) uniform sampler2D transmittance;
+
+void main()
+{
+    // the frame and the targets are rendered alike, texels match fragments whatever the backend's origin
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float alpha = 1.0 - exp(-texelFetch(transmittance, texel, 0).r);
+    vec4 sum = texelFetch(accumulation, texel, 0);
+    vec3 color = sum.rgb / max(sum.a, 1e-5);
+    // the translucent parts over the opaque ones, the frame itself is replaced
+    fragColor = vec4(mix(texelFetch(opaque, texel, 0).rgb, color, alpha), 1.0);
+}